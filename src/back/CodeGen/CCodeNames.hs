@@ -425,6 +425,9 @@ typeNamePrefix ref
 ponySendvName :: CCode Name
 ponySendvName = Nam "pony_sendv"
 
+encoreSendvFutureName :: CCode Name
+encoreSendvFutureName = Nam "encore_sendv_future"
+
 ponyGcSendName :: CCode Name
 ponyGcSendName = Nam "pony_gc_send"
 
@@ -176,8 +176,7 @@ dispatchFunDecl cdecl@(A.Class{A.cname, A.cfields, A.cmethods}) =
                      gcReceive ++ [pMethodDecl, methodCall])
            where
              (pMethodArrName, pMethodDecl) = arrMethodTypeVars mdecl
-             gcReceive = gcRecv mParams
-                         (Comm "Not tracing the future in a oneWay send")
+             gcReceive = gcRecvOneway mParams
              methodCall =
                Statement $
                  if null $ Util.filter A.isForward (A.mbody mdecl)
@@ -261,7 +260,7 @@ translatePassiveClass cdecl@(A.Class{A.cname, A.cfields, A.cmethods}) table =
     [constructorImpl Passive cname] ++
     methodImpls cdecl table cmethods ++
     -- [dispatchfunDecl] ++
-    [runtimePassiveTypeDecl cname]
+    [runtimePassiveTypeDecl cname table]
   where
     dispatchfunDecl =
       Function (Static void) (classDispatchName cname)
@@ -367,11 +366,16 @@ runtimeTypeDecl cname =
       , (Nam "vtable", AsExpr . AsLval $ traitMethodSelectorName)
       ]
 
-runtimePassiveTypeDecl cname =
+-- | Instances of a deeply immutable class are traced as immutable, so
+-- the garbage collector of an actor receiving one does not trace through
+-- it again every time it is sent
+runtimePassiveTypeDecl cname table =
   AssignTL
    (Decl (Typ "pony_type_t", AsLval $ runtimeTypeName cname)) $
       DesignatedInitializer $ [ (Nam "id", AsExpr . AsLval $ classId cname)
       , (Nam "size", Call (Nam "sizeof") [AsLval $ classTypeName cname])
       , (Nam "trace", AsExpr . AsLval $ (classTraceFnName cname))
       , (Nam "vtable", AsExpr . AsLval $ traitMethodSelectorName)
-      ]
+      ] ++
+      [(Nam "immutable", AsExpr . AsLval $ Nam "true")
+      | isDeeplyImmutable cname table]
@@ -4,6 +4,7 @@ module CodeGen.ClassTable (
   lookupMethods,
   lookupField,
   lookupCalledType,
+  isDeeplyImmutable,
   lookupFunction,
   buildProgramTable,
   withLocalFunctions,
@@ -120,5 +121,29 @@ lookupCalledType ty m table@ProgramTable{ctable}
       in
         fst . fromMaybe fail $ find (isJust . snd) results
 
+-- | Is every object reachable from an instance of the class @cls@
+-- immutable? This holds for a read class whose fields are all primitive,
+-- actors, C data or instances of such classes. Read traits, arrays,
+-- closures and type parameters may hide mutable state, as may a class with
+-- a trace method of its own, so they are ruled out.
+isDeeplyImmutable :: Type -> ProgramTable -> Bool
+isDeeplyImmutable cls ProgramTable{ctable} = deep [] cls
+  where
+    deep seen ty
+      | getId ty `elem` seen = True
+      | otherwise =
+          let (fs, ms) = lookupClassEntry ty ctable
+              traceName = Name $ getId ty ++ "_trace"
+          in isReadSingleType ty &&
+             isNothing (lookup traceName ms) &&
+             all (immutableField (getId ty : seen) . ftype . snd) fs
+    immutableField seen ty
+      | isPrimitive ty = True
+      | isCType ty = True
+      | isRefAtomType ty &&
+        (isActiveSingleType ty || isSharedSingleType ty) = True
+      | isClassType ty = deep seen ty
+      | otherwise = False
+
 getGlobalFunctionNames :: ProgramTable -> [QualifiedName]
 getGlobalFunctionNames ProgramTable{ftable} = map fst ftable
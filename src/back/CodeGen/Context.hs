@@ -12,6 +12,9 @@ module CodeGen.Context (
   substAdd,
   substLkp,
   substRem,
+  knownClosureAdd,
+  knownClosureLkp,
+  knownClosureRem,
   genNamedSym,
   genSym,
   getGlobalFunctionNames,
@@ -39,6 +42,8 @@ type NextSym = Int
 
 type VarSubTable = [(Name, C.CCode C.Lval)] -- variable substitutions (for supporting, for instance, nested var decls)
 
+type KnownClosureTable = [(Name, String)] -- closures that never escape, mapped to their meta id
+
 data ExecContext =
     FunctionContext{fun :: Function}
   | MethodContext  {mdecl :: MethodDecl}
@@ -48,6 +53,7 @@ data ExecContext =
 
 data Context = Context {
   varSubTable  :: VarSubTable,
+  knownClosures :: KnownClosureTable,
   nextSym      :: NextSym,
   execContext  :: ExecContext,
   programTbl   :: Tbl.ProgramTable,
@@ -60,6 +66,7 @@ programTable Context{programTbl} = programTbl
 new :: VarSubTable -> Tbl.ProgramTable -> Context
 new subs table = Context {
     varSubTable = subs
+    ,knownClosures = []
     ,nextSym = 0
     ,execContext = Empty
     ,programTbl = table
@@ -68,6 +75,7 @@ new subs table = Context {
 
 newWithForwarding subs table = Context {
     varSubTable = subs
+    ,knownClosures = []
     ,nextSym = 0
     ,execContext = Empty
     ,programTbl = table
@@ -104,6 +112,21 @@ substLkp ctx@Context{varSubTable} QName{qnspace = Just ns, qnlocal}
      | isEmptyNamespace ns = lookup qnlocal varSubTable
      | otherwise = Nothing
 
+knownClosureAdd :: Context -> Name -> String -> Context
+knownClosureAdd ctx@Context{knownClosures} na metaId =
+  ctx{knownClosures = (na, metaId):knownClosures}
+
+knownClosureRem :: Context -> Name -> Context
+knownClosureRem ctx@Context{knownClosures} na =
+  ctx{knownClosures = filter ((/= na) . fst) knownClosures}
+
+knownClosureLkp :: Context -> QualifiedName -> Maybe String
+knownClosureLkp ctx@Context{knownClosures} QName{qnspace = Nothing, qnlocal} =
+  lookup qnlocal knownClosures
+knownClosureLkp ctx@Context{knownClosures} QName{qnspace = Just ns, qnlocal}
+  | isEmptyNamespace ns = lookup qnlocal knownClosures
+  | otherwise = Nothing
+
 setExecCtx :: Context -> ExecContext -> Context
 setExecCtx ctx execContext = ctx{execContext}
 
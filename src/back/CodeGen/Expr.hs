@@ -502,12 +502,21 @@ instance Translatable A.Expr (State Ctx.Context (CCode Lval, CCode Stat)) where
                          ,theAssign
                          ])
 
-  translate (A.Let {A.decls, A.body}) = do
-    tmpsTdecls <- mapM translateDecl decls
+  translate (A.Let {A.mutability, A.decls, A.body}) = do
+    tmpsTdecls <- zipWithM translateLetDecl decls (tail $ tails decls)
     let (tmps, tdecls) = unzip tmpsTdecls
     (nbody, tbody) <- translate body
     mapM_ (mapM_ (unsubstituteVar . A.varName) . fst) decls
+    mapM_ (mapM_ (forgetKnownClosure . A.varName) . fst) decls
     return (nbody, Seq $ concat tdecls ++ [tbody])
+    where
+      translateLetDecl ([var], clos@A.Closure{}) rest
+        | mutability == A.Val
+        , not $ Util.isForwardInExpr clos
+        , all (Util.isOnlyCalledIn $ A.varName var) (body : map snd rest) =
+            translateKnownClosure (A.varName var) clos
+      translateLetDecl decl _ = translateDecl decl
+      forgetKnownClosure x = modify (`Ctx.knownClosureRem` x)
 
   translate new@(A.NewWithInit {A.ty, A.args})
     | Ty.isActiveSingleType ty = delegateUse callTheMethodOneway
@@ -1235,11 +1244,8 @@ instance Translatable A.Expr (State Ctx.Context (CCode Lval, CCode Stat)) where
     futClos <- Ctx.genNamedSym "fut_closure"
     globalFunctionNames <- gets Ctx.getGlobalFunctionNames
     isAsyncForward <- gets Ctx.isAsyncForward
-    let bound = map (ID.qLocal . A.pname) eparams
-        freeVars = filter (ID.isLocalQName . fst) $
-                   Util.freeVariables bound body
-        ty = runtimeType . A.getType $ body
-    fillEnv <- insertAllVars freeVars fTypeVars
+    let ty = runtimeType . A.getType $ body
+    fillEnv <- fillClosureEnv clos
     return
       (Var tmp,
        Seq $
@@ -1268,42 +1274,20 @@ instance Translatable A.Expr (State Ctx.Context (CCode Lval, CCode Stat)) where
       funName   = closureFunName metaId
       envName   = closureEnvName metaId
       traceName = closureTraceName metaId
-      fTypeVars  = Util.freeTypeVars body
       mkEnv name =
         Assign (Decl (Ptr $ Struct name, AsLval name))
           (Call encoreAllocName [AsExpr (Deref encoreCtxVar), Sizeof $ Struct name])
-      insertAllVars vars typeVars =
-        liftM2 (++)
-          (mapM insertVar vars)
-          (filterM localTypeVar typeVars >>= mapM insertTypeVar)
-
-      insertVar (name, _) = do
-        c <- get
-
-        let tname = fromMaybe (AsLval $ globalClosureName name)
-                              (Ctx.substLkp c name)
-        return $ assignVar (fieldName (ID.qnlocal name)) tname
-      insertTypeVar ty = do
-        c <- get
-        let
-          Just tname = Ctx.substLkp c name
-          fName = typeVarRefName ty
-        return $ assignVar fName tname
-        where
-          name = ID.qName $ Ty.getId ty
       assignVar :: (UsableAs e Expr) => CCode Name -> CCode e -> CCode Stat
       assignVar lhs rhs = Assign ((Deref envName) `Dot` lhs) rhs
-      localTypeVar ty = do
-        c <- get
-        return $ isJust $ Ctx.substLkp c name
-        where
-          name = ID.qName $ Ty.getId ty
 
   translate fcall@(A.FunctionCall{A.qname, A.args}) = do
     ctx <- get
-    case Ctx.substLkp ctx qname of
-      Just clos -> closureCall clos fcall
-      Nothing -> functionCall fcall
+    case Ctx.knownClosureLkp ctx qname of
+      Just metaId -> knownClosureCall metaId fcall
+      Nothing ->
+        case Ctx.substLkp ctx qname of
+          Just clos -> closureCall clos fcall
+          Nothing -> functionCall fcall
 
   translate other = error $ "Expr.hs: can't translate: '" ++ show other ++ "'"
 
@@ -1317,15 +1301,80 @@ getDtraceExit eCtx =
       dtraceClosureExit
     _ -> error "Expr.hs: No context to forward from"
 
+-- | Fills in the environment of a closure, which must already be
+-- declared under the name given by 'closureEnvName'.
+fillClosureEnv :: A.Expr -> State Ctx.Context [CCode Stat]
+fillClosureEnv clos@(A.Closure{A.eparams, A.body}) =
+  liftM2 (++)
+    (mapM insertVar freeVars)
+    (filterM localTypeVar fTypeVars >>= mapM insertTypeVar)
+  where
+    bound = map (ID.qLocal . A.pname) eparams
+    freeVars = filter (ID.isLocalQName . fst) $
+               Util.freeVariables bound body
+    fTypeVars = Util.freeTypeVars body
+    envName = closureEnvName . Meta.getMetaId . A.getMeta $ clos
+    insertVar (name, _) = do
+      c <- get
+      let tname = fromMaybe (AsLval $ globalClosureName name)
+                            (Ctx.substLkp c name)
+      return $ assignVar (fieldName (ID.qnlocal name)) tname
+    insertTypeVar ty = do
+      c <- get
+      let
+        Just tname = Ctx.substLkp c name
+        fName = typeVarRefName ty
+      return $ assignVar fName tname
+      where
+        name = ID.qName $ Ty.getId ty
+    assignVar :: (UsableAs e Expr) => CCode Name -> CCode e -> CCode Stat
+    assignVar lhs rhs = Assign ((Deref envName) `Dot` lhs) rhs
+    localTypeVar ty = do
+      c <- get
+      return $ isJust $ Ctx.substLkp c name
+      where
+        name = ID.qName $ Ty.getId ty
+
+-- | Translates a let-bound closure that never escapes its scope (see
+-- 'Util.isOnlyCalledIn'). No @closure_t@ is created: the environment
+-- lives on the stack and every call goes straight to the closure
+-- function (see 'knownClosureCall').
+translateKnownClosure :: ID.Name -> A.Expr ->
+  State Ctx.Context (CCode Lval, [CCode Stat])
+translateKnownClosure x clos = do
+  storage <- Ctx.genNamedSym "env_storage"
+  fillEnv <- fillClosureEnv clos
+  modify $ \c -> Ctx.knownClosureAdd c x metaId
+  return (unit,
+          [Comm $ show x ++ " = " ++ show (PP.ppSugared clos)
+          ,Statement $ Decl (Struct envName, Var storage)
+          ,Assign (Decl (Ptr $ Struct envName, AsLval envName))
+                  (Amp $ Var storage)
+          ] ++ fillEnv)
+  where
+    metaId = Meta.getMetaId . A.getMeta $ clos
+    envName = closureEnvName metaId
+
+knownClosureCall :: String -> A.Expr ->
+  State Ctx.Context (CCode Lval, CCode Stat)
+knownClosureCall metaId =
+  closureCallWith $ \args ->
+    Call (closureFunName metaId)
+         [encoreCtxVar, nullVar, args, AsLval $ closureEnvName metaId]
+
 closureCall :: CCode Lval -> A.Expr ->
   State Ctx.Context (CCode Lval, CCode Stat)
-closureCall clos fcall@A.FunctionCall{A.qname, A.args} = do
+closureCall clos =
+  closureCallWith $ \args -> Call closureCallName [encoreCtxVar, clos, args]
+
+closureCallWith :: (CCode Lval -> CCode Expr) -> A.Expr ->
+  State Ctx.Context (CCode Lval, CCode Stat)
+closureCallWith call fcall@A.FunctionCall{A.qname, A.args} = do
   targs <- mapM translateArgument args
   (tmpArgs, tmpArgDecl) <- tmpArr (Typ "value_t") targs
   (calln, theCall) <- namedTmpVar "clos" typ $
     AsExpr $
-      fromEncoreArgT (translate typ) $
-        Call closureCallName [encoreCtxVar, clos, tmpArgs]
+      fromEncoreArgT (translate typ) $ call tmpArgs
   return (if Ty.isUnitType typ then unit else calln
          ,Seq [tmpArgDecl
               ,dtraceClosureCall qname (extractArgs tmpArgs (length args))
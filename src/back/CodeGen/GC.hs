@@ -1,5 +1,6 @@
 module CodeGen.GC (gcSend
                   ,gcRecv
+                  ,gcRecvOneway
                   ,ponyGcSendFuture
                   ,ponyGcSendStream
                   ,ponyGcSendOneway) where
@@ -22,6 +23,18 @@ gcRecv params traceFun = [Embed $ "",
     traceEachParam A.Param{A.pname, A.ptype} =
       Statement $ traceVariable ptype $ AsLval $ argName pname
 
+-- | A oneway message whose arguments are all primitive carries no
+-- references, so there is nothing to trace on either side
+tracesNothing :: [Ty.Type] -> Bool
+tracesNothing = all Ty.isPrimitive
+
+gcRecvOneway :: [A.ParamDecl] -> [CCode Stat]
+gcRecvOneway params
+  | tracesNothing (map A.ptype params) =
+      [Comm "No GC on receive, all arguments are primitive"]
+  | otherwise =
+      gcRecv params (Comm "Not tracing the future in a oneWay send")
+
 gcSend as expectedTypes traceFuns =
     [Embed $ "",
      Embed $ "// --- GC on sending ----------------------------------------",
@@ -48,5 +61,8 @@ ponyGcSendStream argPairs =
   ponyGcSend argPairs (traceStream $ Var "_stream")
 
 ponyGcSendOneway :: [(Ty.Type, CCode Lval)] -> [CCode Stat]
-ponyGcSendOneway argPairs =
-  ponyGcSend argPairs (Comm "No tracing future for oneway msg")
+ponyGcSendOneway argPairs
+  | tracesNothing (map fst argPairs) =
+      [Comm "No GC on sending, all arguments are primitive"]
+  | otherwise =
+      ponyGcSend argPairs (Comm "No tracing future for oneway msg")
@@ -294,8 +294,11 @@ sendFutMsg cname mname args tparams =
   let
     (msgId, msgTypeName) = (uncurry futMsgId &&& uncurry futMsgTypeName) (cname, mname)
     argPairs = mkArgPairs args tparams ++ [(futNam, futNam)]
+    send target msg =
+      Call encoreSendvFutureName [AsExpr $ Deref encoreCtxVar, target, msg,
+                                  AsExpr $ AsLval futNam]
   in
-    sendMsg cname mname msgId msgTypeName argPairs
+    sendMsgWith send msgId msgTypeName argPairs
 
 sendOneWayMsg :: Ty.Type -> ID.Name -> [CCode Name] -> [CCode Name] -> [CCode Stat]
 sendOneWayMsg cname mname args tparams =
@@ -316,7 +319,16 @@ sendStreamMsg cname mname args tparams =
 sendMsg :: Ty.Type -> ID.Name -> CCode Name -> CCode Name
   -> [(CCode Name, CCode Name)]
   -> [CCode Stat]
-sendMsg cname mname msgId msgTypeName argPairs = [
+sendMsg _ _ = sendMsgWith ponySend
+  where
+    ponySend target msg =
+      Call ponySendvName [AsExpr $ Deref encoreCtxVar, target, msg]
+
+sendMsgWith :: (CCode Expr -> CCode Expr -> CCode Expr)
+  -> CCode Name -> CCode Name
+  -> [(CCode Name, CCode Name)]
+  -> [CCode Stat]
+sendMsgWith send msgId msgTypeName argPairs = [
   assignMsg
   , initMsg
   , sendMsg
@@ -338,5 +350,4 @@ sendMsg cname mname msgId msgTypeName argPairs = [
 
     target = Cast (Ptr ponyActorT) $ thisVar
     msgArg = Cast (Ptr ponyMsgT) $ Var msgName
-    sendMsg = Statement $
-      Call ponySendvName [AsExpr $ Deref encoreCtxVar, target, msgArg]
+    sendMsg = Statement $ send target msgArg
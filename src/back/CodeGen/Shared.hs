@@ -26,6 +26,9 @@ generateShared prog@(A.Program{A.source, A.classes, A.functions, A.imports}) tab
       [commentSection "Global functions"] ++
       globalFunctions ++
 
+      [commentSection "Message names"] ++
+      [msgNames] ++
+
       [mainFunction]
     where
       globalFunctions =
@@ -57,10 +60,36 @@ generateShared prog@(A.Program{A.source, A.classes, A.functions, A.imports}) tab
                AssignTL (Decl (ponyMsgT, Var "m_run_closure"))
                         (Record [Int 3, Record [encorePrimitive, encorePrimitive, encorePrimitive]])
 
+      -- The names of the message ids, in the order of the enum in
+      -- the header, for the --encoreprofile report
+      msgNames =
+          AssignTL (Decl (Typ "static const encore_msg_name_t",
+                          Var "_enc__msg_names[]"))
+                   (Record $ map msgName (futMsgs ++ oneWayMsgs) ++
+                             [Record [Int 0, Int 0, Null]])
+          where
+            -- Message ids are only unique within a class, so entries are
+            -- keyed by the receiving class. Passive objects never receive
+            -- messages. The classes of imported modules are part of the
+            -- program by the time it reaches code generation.
+            meta = [(A.cname c, A.methodName m) | c <- classes,
+                                                  not (A.isPassive c),
+                                                  m <- A.cmethods c]
+            futMsgs = [(futMsgId cname mname, cname, mname) |
+                       (cname, mname) <- meta]
+            oneWayMsgs = [(oneWayMsgId cname mname, cname, mname) |
+                          (cname, mname) <- meta]
+            msgName (msgId, cname, mname) =
+                Record [AsExpr . AsLval $ classId cname,
+                        AsExpr $ AsLval msgId,
+                        String $ getId cname ++ "." ++ show mname]
+
       mainFunction =
           Function (Typ "int") (Nam "main")
                    [(Typ "int", Var "argc"), (Ptr . Ptr $ char, Var "argv")]
-                   $ Return encoreStart
+                   $ Seq [Statement $ Call (Nam "encore_register_msg_names")
+                                           [AsExpr $ Var "_enc__msg_names"]
+                         ,Return encoreStart]
           where
             encoreStart =
                 case find isLocalMain classes of
@@ -22,6 +22,8 @@ traceVariable t var
     Ty.isActiveSingleType t = traceActor var
   | Ty.isRefAtomType t &&
     Ty.isSharedSingleType t = traceActor var
+  | Ty.isClassType t &&
+    Ty.isReadSingleType t   = traceCapability var -- May be deeply immutable
   | Ty.isClassType t        = traceObject var $ classTraceFnName t
   | Ty.isCapabilityType t   = traceCapability var
   | Ty.isFutureType t       = traceObject var futureTraceFn
@@ -21,6 +21,12 @@ import qualified Data.List.NonEmpty as NE(head)
 import Data.Maybe
 import Data.String.Utils
 import Control.Monad
+import Data.Hashable(hash)
+import Data.Word(Word64)
+import Data.Time.Clock(NominalDiffTime, getCurrentTime, diffUTCTime)
+import System.IO.Error(catchIOError)
+import Numeric(showHex)
+import GHC.Conc(getNumProcessors)
 import qualified Data.Map.Strict as Map
 import SystemUtils
 import Language.Haskell.TH -- for Template Haskell hackery
@@ -72,6 +78,7 @@ data Option =
             | Verbose
             | Literate
             | NoGC
+            | CacheDir FilePath
             | Help
             | Undefined String
             | Malformed String
@@ -120,6 +127,8 @@ optionMappings =
         "Embed profiling information in the executable."),
        (NoArg Run, "", "--run", "",
         "Compile and run the program, but do not produce executable file."),
+       (Arg CacheDir, "", "--cache", "[dir]",
+        "Keep object files in [dir] and only recompile generated C files that changed."),
        (NoArg NoGC, "", "--no-gc", "",
         "DEBUG: disable GC and use C-malloc for allocation."),
        (NoArg Help, "", "--help", "",
@@ -243,7 +252,9 @@ compileProgram prog sourcePath options =
            customFlags = case find isCustomFlags options of
                            Just (CustomFlags str) -> str
                            Nothing                -> ""
-           flags = "-std=gnu11 -Wall -fms-extensions -Wno-format -Wno-microsoft -Wno-parentheses-equality -Wno-unused-variable -Wno-unused-value" <+> customFlags <+> "-lpthread -ldl -lm -Wno-attributes"
+           cFlags = "-std=gnu11 -Wall -fms-extensions -Wno-format -Wno-microsoft -Wno-parentheses-equality -Wno-unused-variable -Wno-unused-value" <+> customFlags
+           ldFlags = "-lpthread -ldl -lm -Wno-attributes"
+           flags = cFlags <+> ldFlags
            oFlag = "-o" <+> execName
            defines = getDefines options
            incs  = "-I" <+> incPath <+> "-I ."
@@ -256,6 +267,11 @@ compileProgram prog sourcePath options =
            cmd   = pg <+> opt <+> flags <+> libs <+> incs <+> debug
            compileCmd = cc <+> cmd <+> oFlag <+> unwords classFiles <+>
                         sharedFile <+> libs <+> libs <+> defines
+           objectCmd = cc <+> pg <+> opt <+> cFlags <+> "-Wno-attributes" <+>
+                       incs <+> debug <+> defines
+           linkCmd objects = cc <+> pg <+> opt <+> debug <+> customFlags <+>
+                             oFlag <+> unwords objects <+> libs <+> libs <+>
+                             ldFlags
        withFile headerFile WriteMode (output header)
        withFile sharedFile WriteMode (output shared)
        withFile makefile   WriteMode (output $
@@ -263,7 +279,14 @@ compileProgram prog sourcePath options =
        when ((TypecheckOnly `notElem` options) || (Run `elem` options))
            (do files  <- getDirectoryContents "."
                let ofilesInc = unwords (filter (isSuffixOf ".o") files)
-               exitCode <- system $ compileCmd <+> ofilesInc
+               exitCode <-
+                 case find isCacheDir options of
+                   Just (CacheDir cacheDir) -> do
+                     objects <- compileCached cacheDir encorecPath
+                                  [incPath, libPath] objectCmd
+                                  (show header) (classFiles ++ [sharedFile])
+                     system $ linkCmd objects <+> ofilesInc
+                   Nothing -> system $ compileCmd <+> ofilesInc
                case exitCode of
                  ExitSuccess -> return ()
                  ExitFailure n ->
@@ -282,11 +305,100 @@ compileProgram prog sourcePath options =
       isCustomFlags (CustomFlags _) = True
       isCustomFlags _ = False
 
+      isCacheDir (CacheDir _) = True
+      isCacheDir _ = False
+
       getDefines = unwords . map ("-D"++) .
                    filter (/= "") . map getDefine
       getDefine NoGC = "NO_GC"
       getDefine _ = ""
 
+-- | Compile each generated C file to its own object file in the cache
+-- directory. An object is keyed by a hash of everything that goes into
+-- it (the C file, the shared header, the compiler command, the encorec
+-- binary and the runtime headers and libraries, which `make pony` can
+-- rebuild on their own), so files whose input did not change are not
+-- recompiled. The remaining files are compiled in parallel, one process
+-- per processor. Objects that have not been used for 'cacheMaxAge' are
+-- removed from the cache.
+compileCached :: FilePath -> FilePath -> [FilePath] -> String -> String
+              -> [FilePath] -> IO [FilePath]
+compileCached cacheDir encorecPath runtimeDirs objectCmd header files = do
+  createDirectoryIfMissing True cacheDir
+  stamp <- show <$> getModificationTime encorecPath
+  runtime <- show <$> concatMapM stamps runtimeDirs
+  now <- getCurrentTime
+  objects <- forM files $ \file -> do
+    contents <- readFile file
+    let key = hash (stamp, runtime, objectCmd, header, contents)
+        hex = showHex (fromIntegral key :: Word64) ""
+        object = cacheDir </> changeFileExt (basename file) "" ++
+                 "-" ++ hex ++ ".o"
+    -- Marks the object as used, and fails if it is not in the cache
+    cached <- (setModificationTime object now >> return True)
+                `catchIOError` const (return False)
+    return (file, object, cached)
+  n <- getNumProcessors
+  mapM_ compileBatch $ batches n [(file, object) | (file, object, False) <- objects]
+  evict now
+  return [object | (_, object, _) <- objects]
+  where
+    batches _ [] = []
+    batches n xs = let (batch, rest) = splitAt n xs
+                   in batch : batches n rest
+
+    -- Other encorec runs may compile the same object at the same time,
+    -- so each compiles to a file of its own and renames it when done
+    compileBatch batch = do
+      processes <- forM batch $ \(file, object) -> do
+        (tmp, handle) <- openTempFile cacheDir (basename object <.> "tmp")
+        hClose handle
+        process <- spawnCommand $ objectCmd <+> "-c" <+> file <+> "-o" <+> tmp
+        return (tmp, process)
+      exitCodes <- mapM (waitForProcess . snd) processes
+      forM_ (zip3 batch processes exitCodes) $
+        \((file, object), (tmp, _), exitCode) ->
+          case exitCode of
+            ExitSuccess -> renameFile tmp object
+            ExitFailure n -> do
+              removeFile tmp
+              abort $ " *** Compilation of" <+> file <+>
+                      "failed with exit code" <+> show n <+> "***"
+
+    stamps dir = do
+      exists <- doesDirectoryExist dir
+      if not exists
+        then return []
+        else do
+          entries <- sort . filter (`notElem` [".", ".."]) <$>
+                     getDirectoryContents dir
+          flip concatMapM entries $ \entry -> do
+            let path = dir </> entry
+            isDir <- doesDirectoryExist path
+            if isDir
+              then stamps path
+              else do
+                time <- getModificationTime path
+                return [(entry, show time)]
+
+    -- Another encorec run may be evicting the same files
+    evict now = do
+      entries <- getDirectoryContents cacheDir
+      forM_ (filter isCacheFile entries) $ \entry ->
+        flip catchIOError (const $ return ()) $ do
+          let path = cacheDir </> entry
+          time <- getModificationTime path
+          when (diffUTCTime now time > cacheMaxAge) $
+            removeFile path
+
+    isCacheFile entry = ".o" `isSuffixOf` entry || ".tmp" `isSuffixOf` entry
+
+    concatMapM f xs = concat <$> mapM f xs
+
+-- | How long an object may go unused before it is removed from the cache
+cacheMaxAge :: NominalDiffTime
+cacheMaxAge = 7 * 24 * 60 * 60
+
 main =
     do args <- getArgs
        (programs, importDirs, options) <- parseArguments args
@@ -20,6 +20,7 @@ module AST.Util(
     , isStatement
     , isForwardMethod
     , isForwardInExpr
+    , isOnlyCalledIn
     ) where
 
 import qualified Data.List as List
@@ -489,3 +490,25 @@ isForwardMethod mdecl = not . null . (filter isForward) . mbody $ mdecl
 
 isForwardInExpr :: Expr -> Bool
 isForwardInExpr e = not . null $ filter isForward e
+
+-- | @isOnlyCalledIn x e@ holds when every use of the local variable
+-- @x@ in @e@ is a direct call that is not nested inside a closure or
+-- an async block, and @x@ is never rebound in @e@. A closure bound to
+-- such a variable cannot escape the scope it is defined in.
+isOnlyCalledIn :: Name -> Expr -> Bool
+isOnlyCalledIn x = foldrExp (\e acc -> acc && not (escapes e)) True
+  where
+    isX qname = isLocalQName qname && qnlocal qname == x
+    capturesX e = any (isX . fst) $ freeVariables [] e
+
+    escapes VarAccess{qname} = isX qname
+    escapes FunctionAsValue{qname} = isX qname
+    escapes e@Closure{eparams} =
+      capturesX e || x `elem` map pname eparams
+    escapes e@Async{} = capturesX e
+    escapes Let{decls} = x `elem` concatMap (map varName . fst) decls
+    escapes MiniLet{decl = (vars, _)} = x `elem` map varName vars
+    escapes For{name} = name == x
+    escapes Repeat{name} = name == x
+    escapes Borrow{name} = name == x
+    escapes _ = False
@@ -49,7 +49,7 @@ optimizeProgram p@(Program{classes, traits, functions}) =
 -- | The functions in this list will be performed in order during optimization
 optimizerPasses :: [Expr -> Expr]
 optimizerPasses = [constantFolding, sugarPrintedStrings, tupleMaybeIdComparison,
-                   dropBorrowBlocks, forwardGeneral]
+                   dropBorrowBlocks, inlineKnownClosures, forwardGeneral]
 
 -- Note that this is not intended as a serious optimization, but
 -- as an example to how an optimization could be made. As soon as
@@ -148,6 +148,105 @@ dropBorrowBlocks = extend dropBorrowBlock
            ,body}
       dropBorrowBlock e = e
 
+-- Inlines closures that are bound by a val-let and only ever called
+-- directly in its scope, e.g.
+--   let inc = fun (x : int) => x + 1 in inc(41)
+-- becomes
+--   let x = 41 in x + 1
+-- The binding is dropped once every call has been replaced, so neither
+-- the closure nor its environment is allocated. Closures that do not
+-- escape but cannot be inlined are called directly by the code
+-- generator instead (see 'translateKnownClosure' in "CodeGen.Expr").
+inlineKnownClosures = extend inlineKnownClosure
+  where
+    inlineKnownClosure e@Let{mutability = Val, decls, body} =
+      case inlineDecls decls body of
+        ([], body') -> body'
+        (decls', body') -> e{decls = decls', body = body'}
+    inlineKnownClosure e = e
+
+    inlineDecls [] body = ([], body)
+    inlineDecls (decl@(vars, rhs):rest) body
+      | [var] <- vars
+      , isClosure rhs
+      , canInline (varName var) rhs scope =
+          (map (fmap (inlineCalls (varName var) rhs)) rest'
+          ,inlineCalls (varName var) rhs body')
+      | otherwise = (decl:rest', body')
+      where
+        (rest', body') = inlineDecls rest body
+        scope = body' : map snd rest'
+
+    canInline x clos@Closure{eparams, body} scope =
+      all (isOnlyCalledIn x) scope &&
+      getType body == getResultType (getType clos) &&
+      null (AST.Util.filter unsafeToInline body) &&
+      not (any (foldrExp (\e acc -> acc || rebinds captured e) False) scope) &&
+      not (any (any (mentions paramNames) . args) calls) &&
+      (length calls <= 1 || exprSize body <= inlineThreshold)
+      where
+        paramNames = map pname eparams
+        captured = [qnlocal qname
+                   | (qname, _) <- freeVariables (map (qLocal . pname) eparams) body
+                   , isLocalQName qname]
+        calls = concatMap (AST.Util.filter (isCallTo x)) scope
+
+    inlineCalls x Closure{eparams, body} = extend inlineCall
+      where
+        inlineCall e@FunctionCall{emeta, args}
+          | isCallTo x e =
+              if null eparams
+              then body
+              else Let{emeta
+                      ,mutability = Val
+                      ,decls = zipWith bindParam eparams args
+                      ,body}
+        inlineCall e = e
+        bindParam Param{pname, ptype} arg
+          | getType arg == ptype = ([VarNoType pname], arg)
+          | otherwise = ([VarType pname ptype], arg)
+
+    isCallTo x FunctionCall{qname} = isLocalQName qname && qnlocal qname == x
+    isCallTo _ _ = False
+
+    -- Constructs that depend on running in their own C function, or
+    -- whose copies would clash when the body is duplicated
+    unsafeToInline e = isClosure e || isTask e || isForward e ||
+                       isReturn e || isEmbed e || isControlTransfer e
+    isTask Async{} = True
+    isTask _ = False
+    isReturn Return{} = True
+    isReturn _ = False
+    isEmbed Embed{} = True
+    isEmbed _ = False
+    isControlTransfer e = case e of
+                            Break{} -> True
+                            Continue{} -> True
+                            Yield{} -> True
+                            Eos{} -> True
+                            Await{} -> True
+                            Suspend{} -> True
+                            _ -> False
+
+    mentions names e = any (\(qname, _) -> isLocalQName qname &&
+                                           qnlocal qname `elem` names)
+                           (freeVariables [] e)
+
+    rebinds names e = case e of
+      Let{decls} -> any ((`elem` names) . varName) (concatMap fst decls)
+      MiniLet{decl = (vars, _)} -> any ((`elem` names) . varName) vars
+      Closure{eparams} -> any ((`elem` names) . pname) eparams
+      For{name} -> name `elem` names
+      Repeat{name} -> name `elem` names
+      Borrow{name} -> name `elem` names
+      Match{clauses} -> any (mentions names . mcpattern) clauses
+      Assign{lhs = VarAccess{qname}} -> qnlocal qname `elem` names
+      Consume{target = VarAccess{qname}} -> qnlocal qname `elem` names
+      _ -> False
+
+    exprSize = foldrExp (\_ n -> n + 1) (0 :: Int)
+    inlineThreshold = 16
+
 forwardGeneral = extend forwardGeneral'
   where
     forwardGeneral' e@(Forward{forwardExpr=MessageSend{}}) = e
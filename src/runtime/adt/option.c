@@ -18,7 +18,7 @@ void option_trace(pony_ctx_t* ctx, void *p){
     if(option->type == ENCORE_ACTIVE){
       encore_trace_actor(ctx, val.p);
     }else if (option->type != ENCORE_PRIMITIVE){
-      encore_trace_object(ctx, val.p, option->type->trace);
+      encore_trace_known(ctx, val.p, option->type);
     }
   }
 }
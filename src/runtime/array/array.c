@@ -1,6 +1,7 @@
 #include "array.h"
 #include "encore.h"
 #include <stdio.h>
+#include <string.h>
 #include <assert.h>
 
 struct array_t
@@ -18,16 +19,196 @@ pony_type_t array_type =
   };
 
 static int int_cmp(const void *a, const void *b) {
-  const intptr_t *ia = (const intptr_t*) a;
-  const intptr_t *ib = (const intptr_t*) b;
-  return *ia - *ib;
+  const int64_t ia = ((const encore_arg_t*) a)->i;
+  const int64_t ib = ((const encore_arg_t*) b)->i;
+  return (ia > ib) - (ia < ib);
 }
 
 /// Only works on arrays of integers, only callable through embed at the present
 void array_qsort(array_t *a, int64_t start, int64_t end)
 {
   struct array_t *p = a;
-  qsort(p->elements + start, end, sizeof(encore_arg_t*), int_cmp);
+  assert(0 <= start && start <= end && (size_t)end <= p->size);
+  qsort(p->elements + start, end - start, sizeof(encore_arg_t), int_cmp);
+}
+
+// Maps a key to a uint64_t whose unsigned order is the order of the key
+static inline uint64_t radix_key(encore_arg_t e, array_key_kind kind)
+{
+  uint64_t bits = (uint64_t)e.i;
+  switch (kind) {
+    case ARRAY_KEY_INT:
+      return bits ^ ((uint64_t)1 << 63);
+    case ARRAY_KEY_REAL:
+      // Flip all bits of negative numbers, only the sign bit of others
+      return bits ^ (-(bits >> 63) | ((uint64_t)1 << 63));
+    default:
+      return bits;
+  }
+}
+
+void array_radix_sort(pony_ctx_t **ctx, array_t *keys, array_key_kind kind,
+                      array_t *values)
+{
+  struct array_t *k = keys;
+  struct array_t *v = values;
+  size_t n = k->size;
+  assert(v == NULL || v->size == n);
+  if (n < 2) {
+    return;
+  }
+
+  // Sort the keys of each element, with its index as the payload, so
+  // that the keys are only converted once and both arrays can be
+  // permuted at the end
+  uint64_t *from = encore_alloc(*ctx, 2 * n * sizeof(uint64_t));
+  uint64_t *to = encore_alloc(*ctx, 2 * n * sizeof(uint64_t));
+  uint64_t *from_idx = from + n;
+  uint64_t *to_idx = to + n;
+  for (size_t i = 0; i < n; i++) {
+    from[i] = radix_key(k->elements[i], kind);
+    from_idx[i] = i;
+  }
+
+  size_t count[256];
+  for (int shift = 0; shift < 64; shift += 8) {
+    memset(count, 0, sizeof(count));
+    for (size_t i = 0; i < n; i++) {
+      count[(from[i] >> shift) & 0xff]++;
+    }
+    // Skip the pass when every key has the same digit
+    if (count[(from[0] >> shift) & 0xff] == n) {
+      continue;
+    }
+    size_t sum = 0;
+    for (int d = 0; d < 256; d++) {
+      size_t c = count[d];
+      count[d] = sum;
+      sum += c;
+    }
+    for (size_t i = 0; i < n; i++) {
+      size_t pos = count[(from[i] >> shift) & 0xff]++;
+      to[pos] = from[i];
+      to_idx[pos] = from_idx[i];
+    }
+    uint64_t *tmp = from; from = to; to = tmp;
+    tmp = from_idx; from_idx = to_idx; to_idx = tmp;
+  }
+
+  encore_arg_t *scratch = (encore_arg_t*)to;
+  for (size_t i = 0; i < n; i++) {
+    scratch[i] = k->elements[from_idx[i]];
+  }
+  memcpy(k->elements, scratch, n * sizeof(encore_arg_t));
+  if (v != NULL) {
+    for (size_t i = 0; i < n; i++) {
+      scratch[i] = v->elements[from_idx[i]];
+    }
+    memcpy(v->elements, scratch, n * sizeof(encore_arg_t));
+  }
+}
+
+static inline bool sort_before(pony_ctx_t **ctx, closure_t *cmp,
+                               encore_arg_t x, encore_arg_t y)
+{
+  value_t args[2] = { x, y };
+  return closure_call(ctx, cmp, args).i > 0;
+}
+
+// Merges src[start, mid) and src[mid, end) into dst[start, end)
+static void merge_into(pony_ctx_t **ctx, closure_t *cmp,
+                       encore_arg_t *src, encore_arg_t *dst,
+                       size_t start, size_t mid, size_t end)
+{
+  size_t i = start, j = mid, k = start;
+  while (i < mid && j < end) {
+    // Take from the right run only if it is strictly smaller
+    if (sort_before(ctx, cmp, src[i], src[j])) {
+      dst[k++] = src[j++];
+    } else {
+      dst[k++] = src[i++];
+    }
+  }
+  while (i < mid) {
+    dst[k++] = src[i++];
+  }
+  while (j < end) {
+    dst[k++] = src[j++];
+  }
+}
+
+// Runs shorter than this are sorted by insertion
+#define SORT_RUN 16
+
+void array_sort_range(pony_ctx_t **ctx, array_t *a, size_t start, size_t end,
+                      closure_t *cmp)
+{
+  struct array_t *p = a;
+  assert(start <= end && end <= p->size);
+  size_t n = end - start;
+  if (n < 2) {
+    return;
+  }
+
+  encore_arg_t *elems = p->elements + start;
+  for (size_t lo = 0; lo < n; lo += SORT_RUN) {
+    size_t hi = lo + SORT_RUN < n ? lo + SORT_RUN : n;
+    for (size_t i = lo + 1; i < hi; i++) {
+      encore_arg_t x = elems[i];
+      size_t j = i;
+      while (j > lo && sort_before(ctx, cmp, elems[j - 1], x)) {
+        elems[j] = elems[j - 1];
+        j--;
+      }
+      elems[j] = x;
+    }
+  }
+  if (n <= SORT_RUN) {
+    return;
+  }
+
+  encore_arg_t *buf = encore_alloc(*ctx, n * sizeof(encore_arg_t));
+  encore_arg_t *src = elems;
+  encore_arg_t *dst = buf;
+  for (size_t width = SORT_RUN; width < n; width *= 2) {
+    for (size_t lo = 0; lo < n; lo += 2 * width) {
+      size_t mid = lo + width < n ? lo + width : n;
+      size_t hi = lo + 2 * width < n ? lo + 2 * width : n;
+      merge_into(ctx, cmp, src, dst, lo, mid, hi);
+    }
+    encore_arg_t *tmp = src; src = dst; dst = tmp;
+  }
+  if (src != elems) {
+    memcpy(elems, src, n * sizeof(encore_arg_t));
+  }
+}
+
+void array_merge_ranges(pony_ctx_t **ctx, array_t *a, size_t start,
+                        size_t mid, size_t end, closure_t *cmp)
+{
+  struct array_t *p = a;
+  assert(start <= mid && mid <= end && end <= p->size);
+  if (start == mid || mid == end ||
+      !sort_before(ctx, cmp, p->elements[mid - 1], p->elements[mid])) {
+    return;
+  }
+
+  // Only the left run needs to be copied out of the way
+  size_t n = mid - start;
+  encore_arg_t *left = encore_alloc(*ctx, n * sizeof(encore_arg_t));
+  memcpy(left, p->elements + start, n * sizeof(encore_arg_t));
+  encore_arg_t *elems = p->elements;
+  size_t i = 0, j = mid, k = start;
+  while (i < n && j < end) {
+    if (sort_before(ctx, cmp, left[i], elems[j])) {
+      elems[k++] = elems[j++];
+    } else {
+      elems[k++] = left[i++];
+    }
+  }
+  while (i < n) {
+    elems[k++] = left[i++];
+  }
 }
 
 void array_trace(pony_ctx_t* ctx, void *p)
@@ -40,7 +221,7 @@ void array_trace(pony_ctx_t* ctx, void *p)
     }
   } else if (array->type != ENCORE_PRIMITIVE) {
     for(size_t i = 0; i < array->size; i++) {
-      encore_trace_object(ctx, array->elements[i].p, array->type->trace);
+      encore_trace_known(ctx, array->elements[i].p, array->type);
     }
   }
 }
@@ -71,11 +252,51 @@ array_t *array_get_chunk(pony_ctx_t **ctx, size_t start,
 
   array_t* const new_array = array_mk(ctx, end-start, array_get_type(a));
   for(size_t index = start; index < end; ++index){
-    array_set(new_array, index, array_get(a, index));
+    array_set(new_array, index - start, array_get(a, index));
   }
   return new_array;
 }
 
+array_t *array_resize(pony_ctx_t **ctx, array_t *a, size_t size)
+{
+  struct array_t *p = a;
+  size_t old_size = p->size;
+  p = encore_realloc(*ctx, p, sizeof(struct array_t) +
+                     sizeof(encore_arg_t) * size);
+  if (size > old_size) {
+    memset(p->elements + old_size, 0,
+           (size - old_size) * sizeof(encore_arg_t));
+  }
+  p->size = size;
+  return p;
+}
+
+void array_move(array_t *a, size_t dst, size_t src, size_t n)
+{
+  struct array_t *p = a;
+  assert(dst + n <= p->size && src + n <= p->size);
+  memmove(p->elements + dst, p->elements + src, n * sizeof(encore_arg_t));
+}
+
+void array_copy(array_t *dst, size_t dst_start, array_t *src,
+                size_t src_start, size_t n)
+{
+  struct array_t *d = dst;
+  struct array_t *s = src;
+  assert(dst_start + n <= d->size && src_start + n <= s->size);
+  memmove(d->elements + dst_start, s->elements + src_start,
+          n * sizeof(encore_arg_t));
+}
+
+void array_fill(array_t *a, size_t start, size_t end, encore_arg_t value)
+{
+  struct array_t *p = a;
+  assert(start <= end && end <= p->size);
+  for (size_t i = start; i < end; i++) {
+    p->elements[i] = value;
+  }
+}
+
 inline size_t array_size(array_t *a)
 {
   return ((struct array_t *)a)->size;
@@ -3,6 +3,7 @@
 
 #include <pony.h>
 #include <encore.h>
+#include <closure.h>
 
 typedef void array_t;
 
@@ -22,8 +23,78 @@ pony_type_t* array_get_type(array_t *a);
 
 void array_set(array_t *a, size_t i, encore_arg_t element);
 
+/** Change the size of an array
+ *
+ * The array may be moved, so only the returned array should be used
+ * afterwards. Elements past the old size are zeroed; when shrinking,
+ * the elements past \p size are lost. Growing by a constant factor
+ * makes a sequence of appends take amortised constant time.
+ *
+ * @return An array of size \p size, starting with the elements of \p a
+ */
+array_t *array_resize(pony_ctx_t **ctx, array_t *a, size_t size);
+
+/** Move \p n elements of an array from \p src to \p dst
+ *
+ * The ranges may overlap.
+ */
+void array_move(array_t *a, size_t dst, size_t src, size_t n);
+
+/** Copy \p n elements from \p src, starting at \p src_start, into
+ *  \p dst, starting at \p dst_start
+ */
+void array_copy(array_t *dst, size_t dst_start, array_t *src,
+                size_t src_start, size_t n);
+
+/** Set the elements in [start, end) of an array to \p value */
+void array_fill(array_t *a, size_t start, size_t end, encore_arg_t value);
+
+/** Sort the elements in [start, end) of an array of ints
+ *
+ * Kept for existing callers; see array_radix_sort for the faster
+ * general version.
+ */
 void array_qsort(array_t *a, int64_t start, int64_t end);
 
+/** How the elements of an array are read as sort keys */
+typedef enum array_key_kind
+{
+  ARRAY_KEY_INT,
+  ARRAY_KEY_UINT,
+  ARRAY_KEY_REAL
+} array_key_kind;
+
+/** Sort an array of ints, uints or reals with an LSD radix sort
+ *
+ * If \p values is not NULL, its elements are moved along with the
+ * elements of \p keys, which must be of the same size. The sort is
+ * stable, so values with equal keys keep their order. Reals are
+ * ordered as by <, with negative zero before zero.
+ *
+ * @param keys The array to sort
+ * @param kind The type of the elements of \p keys
+ * @param values An array to permute along with \p keys, or NULL
+ */
+void array_radix_sort(pony_ctx_t **ctx, array_t *keys, array_key_kind kind,
+                      array_t *values);
+
+/** Stable sort of the elements in [start, end) of an array
+ *
+ * @param cmp A closure of two elements, returning an int that is
+ * negative if the first should go before the second, zero if they are
+ * equal and positive otherwise
+ */
+void array_sort_range(pony_ctx_t **ctx, array_t *a, size_t start, size_t end,
+                      closure_t *cmp);
+
+/** Merge the sorted ranges [start, mid) and [mid, end) of an array
+ *
+ * The merge is stable: of equal elements, those in [start, mid) come
+ * first. Merges of disjoint ranges can run in parallel.
+ */
+void array_merge_ranges(pony_ctx_t **ctx, array_t *a, size_t start,
+                        size_t mid, size_t end, closure_t *cmp);
+
 
 /** Get chunk from array from [start, end)
  *
@@ -0,0 +1,529 @@
+/**
+ * Microbenchmarks of the runtime primitives that compiled programs spend
+ * their time in. Each benchmark prints the time per operation, and those
+ * that can run on several threads print one line per thread count.
+ *
+ * Usage: microbench [name...] [--ponythreads N]
+ *
+ * With names, only the benchmarks whose name starts with one of them run.
+ * The benchmarks run inside an actor, as the primitives expect, so the
+ * runtime options (--ponythreads, --encorestats, ...) apply.
+ */
+#define PONY_WANT_ATOMIC_DEFS
+
+#include <pony.h>
+#include "encore.h"
+#include "future.h"
+#include "closure.h"
+#include "array.h"
+#include "party.h"
+#include "mem/pool.h"
+#include "sched/mpmcq.h"
+#include "sched/cpu.h"
+#include "sched/scheduler.h"
+#include "sched/stats.h"
+#include <stdio.h>
+#include <string.h>
+
+enum
+{
+  MSG_ECHO = 100,
+  MSG_ARM,
+  MSG_TICK,
+  MSG_PRODUCE,
+  MSG_CHURN
+};
+
+typedef struct fut_msg_t
+{
+  pony_msg_t msg;
+  future_t* fut;
+  intptr_t n;
+} fut_msg_t;
+
+typedef struct produce_msg_t
+{
+  pony_msg_t msg;
+  pony_actor_t* sink;
+  intptr_t n;
+} produce_msg_t;
+
+typedef struct worker_t
+{
+  encore_actor_t base;
+  future_t* fut;
+  intptr_t expected;
+  intptr_t seen;
+} worker_t;
+
+static int filter_count;
+static char** filters;
+
+static bool selected(const char* name)
+{
+  if(filter_count == 0)
+    return true;
+
+  for(int i = 0; i < filter_count; i++)
+  {
+    if(strncmp(name, filters[i], strlen(filters[i])) == 0)
+      return true;
+  }
+
+  return false;
+}
+
+static void report(const char* name, const char* param, uint64_t ops,
+  uint64_t ns)
+{
+  printf("%-28s %12s %12llu %12.1f\n", name, param, (unsigned long long)ops,
+    ops > 0 ? (double)ns / (double)ops : 0.0);
+  fflush(stdout);
+}
+
+// Messages carrying a future or an actor are traced like compiled code
+// traces them, so that the receiver holds a reference.
+static void send_fut(pony_ctx_t* ctx, pony_actor_t* to, uint32_t id,
+  future_t* fut, intptr_t n)
+{
+  fut_msg_t* m = (fut_msg_t*)pony_alloc_msg(
+    POOL_INDEX(sizeof(fut_msg_t)), id);
+  m->fut = fut;
+  m->n = n;
+
+  pony_gc_send(ctx);
+  encore_trace_object(ctx, fut, future_trace);
+  pony_send_done(ctx);
+  pony_sendv(ctx, to, &m->msg);
+}
+
+static void recv_fut(pony_ctx_t* ctx, fut_msg_t* m)
+{
+  pony_gc_recv(ctx);
+  encore_trace_object(ctx, m->fut, future_trace);
+  pony_recv_done(ctx);
+}
+
+static void worker_dispatch(pony_ctx_t** ctx, pony_actor_t* a,
+  pony_msg_t* msg)
+{
+  worker_t* w = (worker_t*)a;
+
+  switch(msg->id)
+  {
+    case MSG_ECHO:
+    {
+      fut_msg_t* m = (fut_msg_t*)msg;
+      recv_fut(*ctx, m);
+      future_fulfil(ctx, m->fut, (encore_arg_t){.i = m->n});
+      break;
+    }
+
+    case MSG_ARM:
+    {
+      fut_msg_t* m = (fut_msg_t*)msg;
+      recv_fut(*ctx, m);
+      w->fut = m->fut;
+      w->expected = m->n;
+      w->seen = 0;
+      break;
+    }
+
+    case MSG_TICK:
+    {
+      if(++w->seen == w->expected)
+        future_fulfil(ctx, w->fut, (encore_arg_t){.i = w->seen});
+      break;
+    }
+
+    case MSG_PRODUCE:
+    {
+      produce_msg_t* m = (produce_msg_t*)msg;
+      pony_gc_recv(*ctx);
+      encore_trace_actor(*ctx, m->sink);
+      pony_recv_done(*ctx);
+
+      for(intptr_t i = 0; i < m->n; i++)
+        pony_send(*ctx, m->sink, MSG_TICK);
+      break;
+    }
+
+    case MSG_CHURN:
+    {
+      // Allocate garbage; the heap is collected between messages.
+      fut_msg_t* m = (fut_msg_t*)msg;
+      recv_fut(*ctx, m);
+
+      for(intptr_t i = 0; i < m->n; i++)
+        pony_alloc(*ctx, 64);
+
+      if(m->fut != NULL)
+        future_fulfil(ctx, m->fut, (encore_arg_t){.i = 0});
+      break;
+    }
+  }
+}
+
+static void worker_trace(pony_ctx_t* ctx, void* p)
+{
+  worker_t* w = (worker_t*)p;
+  encore_trace_object(ctx, w->fut, future_trace);
+}
+
+static pony_type_t worker_type =
+{
+  .id = 1001,
+  .size = sizeof(worker_t),
+  .trace = worker_trace,
+  .dispatch = worker_dispatch
+};
+
+static pony_actor_t* new_worker(pony_ctx_t* ctx)
+{
+  return (pony_actor_t*)encore_create(ctx, &worker_type);
+}
+
+//
+// Memory
+//
+
+#define POOL_BATCH 64
+
+static void bench_pool()
+{
+  void* p[POOL_BATCH];
+
+  for(size_t index = 0; index < POOL_COUNT; index++)
+  {
+    size_t size = (size_t)POOL_MIN << index;
+    size_t rounds = ((size_t)1 << 24) / (size > 4096 ? size : 4096);
+    char param[32];
+    snprintf(param, sizeof(param), "%zu bytes", size);
+
+    uint64_t start = ponyint_cpu_nanos();
+
+    for(size_t r = 0; r < rounds; r++)
+    {
+      for(size_t i = 0; i < POOL_BATCH; i++)
+        p[i] = ponyint_pool_alloc(index);
+
+      for(size_t i = 0; i < POOL_BATCH; i++)
+        ponyint_pool_free(index, p[i]);
+    }
+
+    report("pool alloc+free", param, rounds * POOL_BATCH,
+      ponyint_cpu_nanos() - start);
+  }
+}
+
+static void bench_heap(pony_ctx_t** ctx)
+{
+  const intptr_t per_msg = 10000;
+  const intptr_t msgs = 1000;
+  pony_actor_t* w = new_worker(*ctx);
+
+  sched_stats_t before, after;
+  ponyint_sched_stats(&before);
+  uint64_t start = ponyint_cpu_nanos();
+
+  for(intptr_t i = 1; i < msgs; i++)
+    send_fut(*ctx, w, MSG_CHURN, NULL, per_msg);
+
+  future_t* done = future_mk(ctx, ENCORE_PRIMITIVE);
+  send_fut(*ctx, w, MSG_CHURN, done, per_msg);
+  future_get_actor(ctx, done);
+
+  uint64_t ns = ponyint_cpu_nanos() - start;
+  ponyint_sched_stats(&after);
+
+  report("heap alloc+gc", "64 bytes", (uint64_t)(msgs * per_msg), ns);
+
+  uint64_t gcs = after.gc_count - before.gc_count;
+  report("heap gc pause", "per gc", gcs,
+    after.gc_pause_ns - before.gc_pause_ns);
+}
+
+//
+// Actors
+//
+
+static void bench_create(pony_ctx_t** ctx)
+{
+  const intptr_t n = 1000000;
+  uint64_t start = ponyint_cpu_nanos();
+
+  // Each actor runs once and is then unreferenced, as in a fork-join
+  // program.
+  for(intptr_t i = 0; i < n; i++)
+    pony_send(*ctx, new_worker(*ctx), MSG_TICK);
+
+  report("encore_create+send", "short-lived", (uint64_t)n,
+    ponyint_cpu_nanos() - start);
+}
+
+//
+// Futures, closures and context switches
+//
+
+static void bench_future_local(pony_ctx_t** ctx)
+{
+  const uint64_t n = 1000000;
+  uint64_t start = ponyint_cpu_nanos();
+
+  for(uint64_t i = 0; i < n; i++)
+  {
+    future_t* fut = future_mk(ctx, ENCORE_PRIMITIVE);
+    future_fulfil(ctx, fut, (encore_arg_t){.i = (intptr_t)i});
+    future_get_actor(ctx, fut);
+  }
+
+  report("future mk+fulfil+get", "fulfilled", n, ponyint_cpu_nanos() - start);
+}
+
+static void bench_future_remote(pony_ctx_t** ctx)
+{
+  // The actor blocks on every get, so this includes two context switches
+  // and two messages.
+  const uint64_t n = 100000;
+  pony_actor_t* echo = new_worker(*ctx);
+  uint64_t start = ponyint_cpu_nanos();
+
+  for(uint64_t i = 0; i < n; i++)
+  {
+    future_t* fut = future_mk(ctx, ENCORE_PRIMITIVE);
+    send_fut(*ctx, echo, MSG_ECHO, fut, (intptr_t)i);
+    future_get_actor(ctx, fut);
+  }
+
+  report("future mk+fulfil+get", "other actor", n,
+    ponyint_cpu_nanos() - start);
+}
+
+static void bench_suspend(pony_ctx_t** ctx)
+{
+  const uint64_t n = 100000;
+  uint64_t start = ponyint_cpu_nanos();
+
+  for(uint64_t i = 0; i < n; i++)
+    actor_suspend(ctx);
+
+  report("actor save+resume context", "suspend", n,
+    ponyint_cpu_nanos() - start);
+}
+
+static value_t add_one(pony_ctx_t** ctx, pony_type_t** types, value_t args[],
+  void* env)
+{
+  (void)ctx;
+  (void)types;
+  (void)env;
+  return (value_t){.i = args[0].i + 1};
+}
+
+static void bench_closure(pony_ctx_t** ctx)
+{
+  const uint64_t n = 10000000;
+  closure_t* c = closure_mk(ctx, add_one, NULL, NULL, NULL);
+  value_t v = {.i = 0};
+  uint64_t start = ponyint_cpu_nanos();
+
+  for(uint64_t i = 0; i < n; i++)
+    v = closure_call(ctx, c, (value_t[]){v});
+
+  report("closure call", "", n, ponyint_cpu_nanos() - start);
+
+  if(v.i != (intptr_t)n)
+    printf("closure call: wrong result\n");
+}
+
+//
+// Messages
+//
+
+static void bench_messages(pony_ctx_t** ctx)
+{
+  const intptr_t n = 1000000;
+  uint32_t cores = ponyint_sched_cores();
+
+  for(uint32_t pairs = 1; pairs <= cores; pairs *= 2)
+  {
+    pony_actor_t* producers[pairs];
+    produce_msg_t* go[pairs];
+    future_t* done[pairs];
+
+    // Set every pair up before starting any of them.
+    for(uint32_t i = 0; i < pairs; i++)
+    {
+      pony_actor_t* sink = new_worker(*ctx);
+      producers[i] = new_worker(*ctx);
+      done[i] = future_mk(ctx, ENCORE_PRIMITIVE);
+      send_fut(*ctx, sink, MSG_ARM, done[i], n);
+
+      go[i] = (produce_msg_t*)pony_alloc_msg(
+        POOL_INDEX(sizeof(produce_msg_t)), MSG_PRODUCE);
+      go[i]->sink = sink;
+      go[i]->n = n;
+      pony_gc_send(*ctx);
+      encore_trace_actor(*ctx, sink);
+      pony_send_done(*ctx);
+    }
+
+    uint64_t start = ponyint_cpu_nanos();
+
+    for(uint32_t i = 0; i < pairs; i++)
+      pony_sendv(*ctx, producers[i], &go[i]->msg);
+
+    for(uint32_t i = 0; i < pairs; i++)
+      future_get_actor(ctx, done[i]);
+
+    char param[32];
+    snprintf(param, sizeof(param), "%u pairs", pairs);
+    report("alloc_msg+sendv", param, (uint64_t)(n * pairs),
+      ponyint_cpu_nanos() - start);
+  }
+}
+
+//
+// Queues
+//
+
+typedef struct queue_bench_t
+{
+  mpmcq_t* q;
+  uint64_t ops;
+  PONY_ATOMIC(uint32_t)* ready;
+  uint32_t threads;
+} queue_bench_t;
+
+static DECLARE_THREAD_FN(queue_thread)
+{
+  queue_bench_t* b = (queue_bench_t*)arg;
+
+  atomic_fetch_add_explicit(b->ready, 1, memory_order_relaxed);
+
+  while(atomic_load_explicit(b->ready, memory_order_acquire) < b->threads)
+    ;
+
+  for(uint64_t i = 0; i < b->ops; i++)
+  {
+    ponyint_mpmcq_push(b->q, b);
+
+    while(ponyint_mpmcq_pop(b->q) == NULL)
+      ;
+  }
+
+  ponyint_pool_thread_cleanup();
+  return 0;
+}
+
+static void bench_mpmcq()
+{
+  const uint64_t ops = 1000000;
+  uint32_t max = ponyint_cpu_count() * 2;
+
+  for(uint32_t threads = 1; threads <= max; threads *= 2)
+  {
+    mpmcq_t q;
+    ponyint_mpmcq_init(&q);
+    PONY_ATOMIC(uint32_t) ready = 0;
+    pony_thread_id_t tids[threads];
+    queue_bench_t b = {&q, ops / threads, &ready, threads};
+
+    uint64_t start = ponyint_cpu_nanos();
+
+    for(uint32_t i = 0; i < threads; i++)
+      ponyint_thread_create(&tids[i], queue_thread, (uint32_t)-1, &b);
+
+    for(uint32_t i = 0; i < threads; i++)
+      ponyint_thread_join(tids[i]);
+
+    char param[32];
+    snprintf(param, sizeof(param), "%u threads", threads);
+    report("mpmcq push+pop", param, b.ops * threads,
+      ponyint_cpu_nanos() - start);
+    ponyint_mpmcq_destroy(&q);
+  }
+}
+
+//
+// ParT
+//
+
+static void bench_party(pony_ctx_t** ctx)
+{
+  const size_t n = 1000000;
+  array_t* arr = array_mk(ctx, n, ENCORE_PRIMITIVE);
+
+  for(size_t i = 0; i < n; i++)
+    array_set(arr, i, (encore_arg_t){.i = (intptr_t)i});
+
+  closure_t* c = closure_mk(ctx, add_one, NULL, NULL, NULL);
+
+  uint64_t start = ponyint_cpu_nanos();
+  par_t* p = new_par_array(ctx, arr, ENCORE_PRIMITIVE);
+  p = party_sequence(ctx, p, c, ENCORE_PRIMITIVE);
+  party_extract(ctx, p, ENCORE_PRIMITIVE);
+  report("party sequence+extract", "array", n, ponyint_cpu_nanos() - start);
+
+  start = ponyint_cpu_nanos();
+  p = party_each(ctx, arr);
+  p = party_sequence(ctx, p, c, ENCORE_PRIMITIVE);
+  party_extract(ctx, p, ENCORE_PRIMITIVE);
+  report("party sequence+extract", "each", n, ponyint_cpu_nanos() - start);
+}
+
+static void main_dispatch(pony_ctx_t** ctx, pony_actor_t* a, pony_msg_t* msg)
+{
+  (void)a;
+
+  if(msg->id != _ENC__MSG_MAIN)
+    return;
+
+  pony_main_msg_t* m = (pony_main_msg_t*)msg;
+  filter_count = m->argc - 1;
+  filters = m->argv + 1;
+
+  printf("%-28s %12s %12s %12s\n", "benchmark", "", "ops", "ns/op");
+
+  if(selected("pool"))
+    bench_pool();
+
+  if(selected("heap"))
+    bench_heap(ctx);
+
+  if(selected("encore_create"))
+    bench_create(ctx);
+
+  if(selected("future"))
+  {
+    bench_future_local(ctx);
+    bench_future_remote(ctx);
+  }
+
+  if(selected("actor"))
+    bench_suspend(ctx);
+
+  if(selected("closure"))
+    bench_closure(ctx);
+
+  if(selected("alloc_msg"))
+    bench_messages(ctx);
+
+  if(selected("mpmcq"))
+    bench_mpmcq();
+
+  if(selected("party"))
+    bench_party(ctx);
+}
+
+static pony_type_t main_type =
+{
+  .id = 1000,
+  .size = sizeof(encore_actor_t),
+  .dispatch = main_dispatch
+};
+
+int main(int argc, char** argv)
+{
+  return encore_start(argc, argv, &main_type);
+}
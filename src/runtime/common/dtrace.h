@@ -24,11 +24,18 @@
 
 #define DTRACE_ENABLED(name)                         0
 #define DTRACE0(name)                                do {} while (0)
-#define DTRACE1(name, a0)                            do {} while (0)
-#define DTRACE2(name, a0, a1)                        do {} while (0)
-#define DTRACE3(name, a0, a1, a2)                    do {} while (0)
-#define DTRACE4(name, a0, a1, a2, a3)                do {} while (0)
-#define DTRACE5(name, a0, a1, a2, a3, a4)            do {} while (0)
+#define DTRACE1(name, a0)                            \
+  do { (void)sizeof(a0); } while (0)
+#define DTRACE2(name, a0, a1)                        \
+  do { (void)sizeof(a0); (void)sizeof(a1); } while (0)
+#define DTRACE3(name, a0, a1, a2)                    \
+  do { (void)sizeof(a0); (void)sizeof(a1); (void)sizeof(a2); } while (0)
+#define DTRACE4(name, a0, a1, a2, a3)                \
+  do { (void)sizeof(a0); (void)sizeof(a1); (void)sizeof(a2);    \
+       (void)sizeof(a3); } while (0)
+#define DTRACE5(name, a0, a1, a2, a3, a4)            \
+  do { (void)sizeof(a0); (void)sizeof(a1); (void)sizeof(a2);    \
+       (void)sizeof(a3); (void)sizeof(a4); } while (0)
 
 #endif
 
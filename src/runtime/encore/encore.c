@@ -3,14 +3,21 @@
 #include "encore.h"
 #include "closure.h"
 #include "actor/actor.h"
+#include "actor/profile.h"
 #include "sched/scheduler.h"
+#include "sched/stats.h"
+#include "sched/timeline.h"
 #include "mem/pool.h"
+#include "options/options.h"
+#include "../stream/stream.h"
 #include <string.h>
 #include <stdbool.h>
 #include <stdlib.h>
 #include <assert.h>
 #include <ucontext.h>
 #include <stdio.h>
+#include <signal.h>
+#include <unistd.h>
 
 #ifdef LAZY_IMPL
 __attribute__ ((noreturn))
@@ -40,6 +47,13 @@ static void pony_sendargs(pony_ctx_t *ctx, pony_actor_t* to, uint32_t id,
 
 #define MAX_IN_POOL 4
 
+// Maximum number of messages a caller runs on behalf of an idle receiver
+// before giving up on direct dispatch and blocking as usual
+#define DIRECT_DISPATCH_BUDGET 8
+
+// Maximum number of direct dispatches nested in one another
+#define DIRECT_DISPATCH_DEPTH 4
+
 inline static void assert_swap(ucontext_t *old, ucontext_t *new)
 {
   int _ret = swapcontext(old, new);
@@ -53,6 +67,16 @@ static __pony_thread_local unsigned int available_context = 0;
 __pony_thread_local context *root_context;
 __pony_thread_local context *this_context;
 
+static bool direct_dispatch = false;
+static bool print_stats = false;
+static const encore_msg_name_t *msg_names = NULL;
+
+// An idle actor that the current actor has sent a future message to, but
+// not yet scheduled. It is either run inline by `encore_direct_dispatch` or
+// scheduled by `encore_flush_deferred` before the current actor stops.
+static __pony_thread_local pony_actor_t *deferred_actor = NULL;
+static __pony_thread_local future_t *deferred_future = NULL;
+
 void actor_unlock(encore_actor_t *actor)
 {
   if (!pony_system_actor((pony_actor_t*) actor)) {
@@ -83,11 +107,13 @@ static stack_page *pop_page()
   stack_page *page = stack_pool;
   stack_pool = page->next;
   assert(page->stack);
+  STATS_ADD(pony_ctx(), stacks_acquired, 1);
   return page;
 }
 
 static void push_page(stack_page *page)
 {
+  STATS_ADD(pony_ctx(), stacks_released, 1);
   available_pages++;
   page->next = stack_pool;
   stack_pool = page;
@@ -145,11 +171,13 @@ static context *pop_context(encore_actor_t *actor)
   makecontext(&context_pool->uctx, (void(*)(void))public_run, 1, actor);
   c = context_pool;
   context_pool = c->next;
+  STATS_ADD(pony_ctx(), stacks_acquired, 1);
   return c;
 }
 
 static void push_context(context *ctx)
 {
+  STATS_ADD(pony_ctx(), stacks_released, 1);
   available_context++;
   ctx->next = context_pool;
   context_pool = ctx;
@@ -200,6 +228,8 @@ static void force_thread_local_variable_access(context *old_this_context,
 void actor_save_context(pony_ctx_t **ctx, encore_actor_t *actor,
         ucontext_t *uctx)
 {
+  encore_flush_deferred(*ctx);
+
 #ifndef LAZY_IMPL
 
   if (!actor->page) {
@@ -371,15 +401,203 @@ void *encore_realloc(pony_ctx_t *ctx, void* p, size_t s)
     return mem;
 }
 
+static void flush_deferred_actor(pony_ctx_t *ctx)
+{
+  pony_actor_t *actor = deferred_actor;
+  if (actor != NULL) {
+    deferred_actor = NULL;
+    deferred_future = NULL;
+    ponyint_sched_add(ctx, actor);
+  }
+}
+
+void encore_sendv_future(pony_ctx_t *ctx, pony_actor_t *to, pony_msg_t *m,
+        future_t *fut)
+{
+  pony_actor_t *self = ctx->current;
+  if (!direct_dispatch || self == NULL || self == to ||
+      pony_system_actor(self) || pony_system_actor(to)) {
+    pony_sendv(ctx, to, m);
+    return;
+  }
+
+  flush_deferred_actor(ctx);
+  if (ponyint_sendv_deferred(ctx, to, m)) {
+    deferred_actor = to;
+    deferred_future = fut;
+  }
+}
+
+void encore_flush_deferred(pony_ctx_t *ctx)
+{
+  stream_flush(&ctx);
+  flush_deferred_actor(ctx);
+}
+
+bool encore_direct_dispatch(pony_ctx_t **ctx, future_t *fut)
+{
+  if (deferred_actor == NULL) {
+    return false;
+  }
+
+  encore_actor_t *self = (encore_actor_t*)(*ctx)->current;
+  if (deferred_future != fut ||
+      self->dispatch_depth == DIRECT_DISPATCH_DEPTH) {
+    flush_deferred_actor(*ctx);
+    return false;
+  }
+
+  // The target may be waiting for elements we have put in a stream
+  stream_flush(ctx);
+
+  // Nobody else can schedule the receiver until we do, so running its
+  // messages here cannot overlap with another run of the same actor.
+  encore_actor_t *target = (encore_actor_t*)deferred_actor;
+  deferred_actor = NULL;
+  deferred_future = NULL;
+  target->dispatch_depth = self->dispatch_depth + 1;
+
+#ifndef LAZY_IMPL
+  // The target runs on a page of its own: keep ours, like a blocking
+  // actor does, so that it is not handed out again while we are on it
+  stack_page *page = self->page;
+  if (!page) {
+    assert(local_page);
+    self->page = local_page;
+    local_page = NULL;
+  }
+#endif
+
+  bool reschedule = true;
+  for (int i = 0; reschedule && i < DIRECT_DISPATCH_BUDGET &&
+         !future_fulfilled(fut); i++) {
+    reschedule = ponyint_actor_run(ctx, (pony_actor_t*)target, 1);
+#ifndef LAZY_IMPL
+    // As the scheduler does, now that the target is off its stack
+    actor_unlock(target);
+#endif
+  }
+
+#ifndef LAZY_IMPL
+  if (!page) {
+    if (local_page) {
+      push_page(local_page);
+    }
+    local_page = self->page;
+    self->page = NULL;
+  }
+#endif
+
+  // A target that blocked resumed this frame together with its own, and
+  // brought *ctx up to date with the thread that resumed it
+  pony_become(*ctx, (pony_actor_t*)self);
+  if (reschedule) {
+    // Otherwise someone else may be running the target already. It then
+    // keeps a depth that is too large, which only makes it less eager to
+    // run others inline.
+    target->dispatch_depth = 0;
+    ponyint_sched_add(*ctx, (pony_actor_t*)target);
+  }
+
+  return future_fulfilled(fut);
+}
+
+enum
+{
+  OPT_DIRECTDISPATCH,
+  OPT_STATS,
+  OPT_PROFILE,
+  OPT_TRACE
+};
+
+static opt_arg_t args[] =
+{
+  {"encoredirectdispatch", 0, OPT_ARG_NONE, OPT_DIRECTDISPATCH},
+  {"encorestats", 0, OPT_ARG_NONE, OPT_STATS},
+  {"encoreprofile", 0, OPT_ARG_NONE, OPT_PROFILE},
+  {"encoretrace", 0, OPT_ARG_REQUIRED, OPT_TRACE},
+
+  OPT_ARGS_FINISH
+};
+
+static int parse_opts(int argc, char** argv)
+{
+  opt_state_t s;
+  int id;
+  ponyint_opt_init(args, &s, &argc, argv);
+
+  while((id = ponyint_opt_next(&s)) != -1)
+  {
+    switch(id)
+    {
+      case OPT_DIRECTDISPATCH: direct_dispatch = true; break;
+      case OPT_STATS: print_stats = true; break;
+      case OPT_PROFILE: ponyint_profile_enable(); break;
+      case OPT_TRACE:
+        if (!ponyint_timeline_start(s.arg_val)) {
+          fprintf(stderr, "Cannot write trace to %s\n", s.arg_val);
+          exit(-1);
+        }
+        break;
+
+      default: exit(-1);
+    }
+  }
+
+  argv[argc] = NULL;
+  return argc;
+}
+
+void encore_register_msg_names(const encore_msg_name_t *names)
+{
+  msg_names = names;
+}
+
+static const char *msg_name(pony_type_t *type, uint32_t id)
+{
+  switch (id) {
+    case _ENC__MSG_RESUME_GET: return "(resume get)";
+    case _ENC__MSG_RESUME_SUSPEND: return "(resume suspend)";
+    case _ENC__MSG_RESUME_AWAIT: return "(resume await)";
+    case _ENC__MSG_RUN_CLOSURE: return "(run closure)";
+    case _ENC__MSG_MAIN: return "(main)";
+  }
+
+  if (msg_names == NULL) {
+    return NULL;
+  }
+
+  // The table is only read once, when the report is printed
+  for (const encore_msg_name_t *n = msg_names; n->name != NULL; n++) {
+    if (n->type == type->id && n->id == id) {
+      return n->name;
+    }
+  }
+
+  return NULL;
+}
+
 /// The starting point of all Encore programs
 int encore_start(int argc, char** argv, pony_type_t *type)
 {
+  argc = parse_opts(argc, argv);
   argc = pony_init(argc, argv);
   pony_ctx_t *ctx = pony_ctx();
   pony_actor_t* actor = (pony_actor_t *)encore_create(ctx, type);
   pony_sendargs(ctx, actor, _ENC__MSG_MAIN, argc, argv);
 
-  return pony_start(false, false);
+  // The runtime counters can be dumped at any time with kill -USR1
+  ponyint_stats_signal(SIGUSR1);
+
+  int ret = pony_start(false, false);
+  if (print_stats) {
+    ponyint_stats_dump(STDERR_FILENO);
+  }
+  if (ponyint_profiling) {
+    ponyint_profile_report(stderr, msg_name);
+  }
+  ponyint_timeline_stop();
+  return ret;
 }
 
 bool encore_actor_run_hook(encore_actor_t *actor)
@@ -58,12 +58,13 @@ typedef union { encore_arg_t_content; } encore_arg_t;
 typedef enum {
   ID_CLOSURE = 0,
   ID_FUTURE,
-  ID_SCONS,
   ID_ARRAY,
   ID_OPTION,
   ID_TUPLE,
   ID_RANGE,
-  ID_PARTY
+  ID_PARTY,
+  ID_SET,
+  ID_STREAM
 } encore_type_id;
 
 typedef enum {
@@ -100,6 +101,9 @@ struct encore_actor_t
   bool resume;
   int await_counter;
   int suspend_counter;
+  // Number of callers this actor is being run inline for (see
+  // encore_direct_dispatch)
+  int dispatch_depth;
   pthread_mutex_t *lock;
 #ifndef LAZY_IMPL
   ucontext_t uctx;
@@ -136,9 +140,41 @@ void *encore_alloc(pony_ctx_t *ctx, size_t s);
  */
 void *encore_realloc(pony_ctx_t *ctx, void *p, size_t s);
 
+/// The name of a message id sent to actors of a type, as "Class.method"
+typedef struct encore_msg_name_t {
+  uint32_t type;
+  uint32_t id;
+  const char *name;
+} encore_msg_name_t;
+
+/**
+ * Name the message ids of the program in the report printed by
+ * --encoreprofile. The table ends with {0, 0, NULL}.
+ */
+void encore_register_msg_names(const encore_msg_name_t *names);
+
 /// The starting point of all Encore programs
 int encore_start(int argc, char** argv, pony_type_t *type);
 
+/**
+ * Send a message whose result will be delivered through fut.
+ *
+ * With --encoredirectdispatch, an idle receiver is not scheduled right
+ * away: if the sender then gets fut, the receiver is run on the sender's
+ * stack instead (see encore_direct_dispatch). Otherwise it is scheduled as
+ * soon as the sender sends another future message, blocks or finishes its
+ * current message.
+ */
+void encore_sendv_future(pony_ctx_t *ctx, pony_actor_t *to, pony_msg_t *m,
+        future_t *fut);
+
+/// Run the idle receiver of fut inline; returns true if fut got fulfilled
+bool encore_direct_dispatch(pony_ctx_t **ctx, future_t *fut);
+
+/// Publish pending stream elements and schedule the receiver held back
+/// by encore_sendv_future, if any. Called whenever an actor stops running.
+void encore_flush_deferred(pony_ctx_t *ctx);
+
 void actor_unlock(encore_actor_t *actor);
 bool encore_actor_run_hook(encore_actor_t *actor);
 bool encore_actor_handle_message_hook(encore_actor_t *actor, pony_msg_t* msg);
@@ -158,6 +194,20 @@ void call_respond_with_current_scheduler();
 pony_ctx_t* encore_ctx();
 void encore_trace_actor(pony_ctx_t *ctx, pony_actor_t *a);
 void encore_trace_object(pony_ctx_t *ctx, void *p, pony_trace_fn f);
+
+/// Trace an object whose runtime type is known. Instances of deeply
+/// immutable types are traced as immutable, which lets a receiver skip
+/// tracing through them every time they are sent to it.
+static inline void encore_trace_known(
+    pony_ctx_t *ctx,
+    void *p,
+    pony_type_t *type)
+{
+  if (!p) { return; }
+  pony_traceknown(ctx, p, type,
+                  type->immutable ? PONY_TRACE_IMMUTABLE : PONY_TRACE_MUTABLE);
+}
+
 static inline void encore_trace_polymorphic_variable(
     pony_ctx_t* ctx,
     pony_type_t *type,
@@ -168,7 +218,7 @@ static inline void encore_trace_polymorphic_variable(
     if (type == ENCORE_ACTIVE) {
       encore_trace_actor(ctx, x.p);
     } else {
-      pony_traceknown(ctx, x.p, type, PONY_TRACE_MUTABLE);
+      encore_trace_known(ctx, x.p, type);
     }
   }
 }
@@ -188,7 +238,7 @@ static inline void encore_trace_capability(
     void *p)
 {
   if (p) {
-    encore_trace_object(ctx, p, ((capability_t*) p)->_enc__self_type->trace);
+    encore_trace_known(ctx, p, ((capability_t*) p)->_enc__self_type);
   }
 }
 
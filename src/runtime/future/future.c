@@ -14,6 +14,7 @@
 #include "future.h"
 #include "../libponyrt/actor/messageq.h"
 #include "../libponyrt/sched/scheduler.h"
+#include "../libponyrt/sched/timeline.h"
 
 pthread_mutexattr_t attr;
 #define BLOCK    pthread_mutex_lock(&fut->lock);
@@ -146,7 +147,7 @@ static inline void future_gc_trace_value(pony_ctx_t *ctx, future_t *fut)
   if (fut->type == ENCORE_ACTIVE) {
     encore_trace_actor(ctx, fut->value.p);
   } else if (fut->type != ENCORE_PRIMITIVE) {
-    encore_trace_object(ctx, fut->value.p, fut->type->trace);
+    encore_trace_known(ctx, fut->value.p, fut->type);
   }
 }
 
@@ -189,6 +190,7 @@ future_t *future_mk(pony_ctx_t **ctx, pony_type_t *type)
   pthread_mutex_init(&fut->lock, &attr);
 
   ENC_DTRACE3(FUTURE_CREATE, (uintptr_t) ctx, (uintptr_t) fut, (uintptr_t) type);
+  STATS_ADD(cctx, futures_created, 1);
 
   return fut;
 }
@@ -295,9 +297,18 @@ static void acquire_future_value(pony_ctx_t **ctx, future_t *fut)
 // ===============================================================
 encore_arg_t future_get_actor(pony_ctx_t **ctx, future_t *fut)
 {
-  if (!fut->fulfilled) {
+  if (!fut->fulfilled && !encore_direct_dispatch(ctx, fut)) {
     ENC_DTRACE2(FUTURE_BLOCK, (uintptr_t) *ctx, (uintptr_t) fut);
+    pony_actor_t *actor = (*ctx)->current;
+    if (ponyint_timeline_enabled) {
+      ponyint_timeline_record(TIMELINE_FUTURE_BLOCK, 0, (uintptr_t) actor,
+                              (uintptr_t) fut);
+    }
     future_block_actor(ctx, fut);
+    if (ponyint_timeline_enabled) {
+      ponyint_timeline_record(TIMELINE_FUTURE_UNBLOCK, 0, (uintptr_t) actor,
+                              (uintptr_t) fut);
+    }
     ENC_DTRACE2(FUTURE_UNBLOCK, (uintptr_t) *ctx, (uintptr_t) fut);
   }
 
@@ -419,6 +430,7 @@ static void future_block_actor(pony_ctx_t **ctx, future_t *fut)
 
   assert(actor->lock == NULL);
   actor->lock = &fut->lock;
+  STATS_ADD(cctx, futures_blocked, 1);
   actor_block(ctx, actor);
 }
 
@@ -451,6 +463,7 @@ void future_await(pony_ctx_t **ctx, future_t *fut)
 
   assert(actor->lock == NULL);
   actor->lock = &fut->lock;
+  STATS_ADD(cctx, futures_blocked, 1);
   actor_await(ctx, &uctx);
 }
 
@@ -0,0 +1,404 @@
+#include "jsontape.h"
+#include <encore.h>
+#include <string.h>
+
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#define JSON_SSE2
+#endif
+
+// ===============================================================
+// Stage 1: structural index
+// ===============================================================
+
+// Bit masks of the characters of one 64-byte block, bit i standing for
+// byte i of the block
+typedef struct block_masks
+{
+  uint64_t quote;
+  uint64_t backslash;
+  uint64_t space;
+  uint64_t op;   // { } [ ] : ,
+} block_masks;
+
+#ifdef JSON_SSE2
+static inline uint64_t eq_mask(__m128i v[4], char c)
+{
+  const __m128i k = _mm_set1_epi8(c);
+  uint64_t m = 0;
+  for (int i = 0; i < 4; i++) {
+    m |= (uint64_t)(uint16_t)_mm_movemask_epi8(_mm_cmpeq_epi8(v[i], k))
+      << (16 * i);
+  }
+  return m;
+}
+
+static void classify(const char *block, block_masks *m)
+{
+  __m128i v[4];
+  for (int i = 0; i < 4; i++) {
+    v[i] = _mm_loadu_si128((const __m128i*)(block + 16 * i));
+  }
+  m->quote = eq_mask(v, '"');
+  m->backslash = eq_mask(v, '\\');
+  m->space = eq_mask(v, ' ') | eq_mask(v, '\t') | eq_mask(v, '\n') |
+    eq_mask(v, '\r');
+  m->op = eq_mask(v, '{') | eq_mask(v, '}') | eq_mask(v, '[') |
+    eq_mask(v, ']') | eq_mask(v, ':') | eq_mask(v, ',');
+}
+#else
+static void classify(const char *block, block_masks *m)
+{
+  memset(m, 0, sizeof(*m));
+  for (int i = 0; i < 64; i++) {
+    uint64_t bit = (uint64_t)1 << i;
+    switch (block[i]) {
+      case '"': m->quote |= bit; break;
+      case '\\': m->backslash |= bit; break;
+      case ' ': case '\t': case '\n': case '\r': m->space |= bit; break;
+      case '{': case '}': case '[': case ']': case ':': case ',':
+        m->op |= bit; break;
+    }
+  }
+}
+#endif
+
+// Bit i of the result is the parity of bits 0..i of x
+static inline uint64_t prefix_xor(uint64_t x)
+{
+  x ^= x << 1;
+  x ^= x << 2;
+  x ^= x << 4;
+  x ^= x << 8;
+  x ^= x << 16;
+  x ^= x << 32;
+  return x;
+}
+
+// The characters escaped by a backslash. Backslashes are rare, so they
+// are walked one at a time. *carry says whether the first byte of the
+// block is escaped, and is set to whether the first byte of the next
+// one is.
+static inline uint64_t escaped_chars(uint64_t backslash, bool *carry)
+{
+  uint64_t escaped = *carry ? 1 : 0;
+  *carry = false;
+  while (backslash != 0) {
+    int i = __builtin_ctzll(backslash);
+    backslash &= backslash - 1;
+    if (!((escaped >> i) & 1)) {
+      if (i == 63) {
+        *carry = true;
+      } else {
+        escaped |= (uint64_t)1 << (i + 1);
+      }
+    }
+  }
+  return escaped;
+}
+
+int64_t json_structural_index(const char *s, size_t len, uint32_t *out)
+{
+  size_t n = 0;
+  bool escape_carry = false;
+  uint64_t in_string_carry = 0;  // all ones inside a string
+  uint64_t scalar_carry = 0;     // 1 if the last byte was part of a scalar
+  char last_block[64];
+
+  for (size_t pos = 0; pos < len; pos += 64) {
+    const char *block = s + pos;
+    if (len - pos < 64) {
+      // Pad the last block with spaces, which are never structural
+      memset(last_block, ' ', sizeof(last_block));
+      memcpy(last_block, block, len - pos);
+      block = last_block;
+    }
+
+    block_masks m;
+    classify(block, &m);
+
+    uint64_t quote = m.quote;
+    if (m.backslash != 0 || escape_carry) {
+      quote &= ~escaped_chars(m.backslash, &escape_carry);
+    }
+    // Set from an opening quote up to, not including, its closing quote
+    uint64_t in_string = prefix_xor(quote) ^ in_string_carry;
+    in_string_carry = (uint64_t)((int64_t)in_string >> 63);
+
+    uint64_t op = m.op & ~in_string;
+    uint64_t scalar = ~(m.op | m.space | quote) & ~in_string;
+    // Only the first byte of each number or literal is structural
+    uint64_t scalar_start = scalar & ~((scalar << 1) | scalar_carry);
+    scalar_carry = scalar >> 63;
+
+    uint64_t structural = op | quote | scalar_start;
+    while (structural != 0) {
+      out[n++] = (uint32_t)(pos + __builtin_ctzll(structural));
+      structural &= structural - 1;
+    }
+  }
+
+  return in_string_carry ? -1 : (int64_t)n;
+}
+
+// ===============================================================
+// Stage 2: tape
+// ===============================================================
+
+#define TAPE_WORD(tag, payload) \
+  (((uint64_t)(unsigned char)(tag) << 56) | (uint64_t)(payload))
+
+static inline bool is_delimiter(const char *s, size_t len, size_t i)
+{
+  if (i >= len) {
+    return true;
+  }
+  switch (s[i]) {
+    case ' ': case '\t': case '\n': case '\r':
+    case '{': case '}': case '[': case ']': case ':': case ',':
+      return true;
+    default:
+      return false;
+  }
+}
+
+static inline bool is_digit(char c)
+{
+  return (unsigned char)(c - '0') < 10;
+}
+
+// The end of the number starting at i, or 0 if there is none
+static size_t scan_number(const char *s, size_t len, size_t i)
+{
+  if (i < len && s[i] == '-') {
+    i++;
+  }
+  if (i >= len || !is_digit(s[i])) {
+    return 0;
+  }
+  if (s[i] == '0') {
+    i++;
+  } else {
+    while (i < len && is_digit(s[i])) {
+      i++;
+    }
+  }
+  if (i < len && s[i] == '.') {
+    i++;
+    if (i >= len || !is_digit(s[i])) {
+      return 0;
+    }
+    while (i < len && is_digit(s[i])) {
+      i++;
+    }
+  }
+  if (i < len && (s[i] == 'e' || s[i] == 'E')) {
+    i++;
+    if (i < len && (s[i] == '+' || s[i] == '-')) {
+      i++;
+    }
+    if (i >= len || !is_digit(s[i])) {
+      return 0;
+    }
+    while (i < len && is_digit(s[i])) {
+      i++;
+    }
+  }
+  return i;
+}
+
+static inline bool is_hex_digit(char c)
+{
+  return is_digit(c) || (unsigned char)((c | 0x20) - 'a') < 6;
+}
+
+// Whether the contents s[i..end) of a string have valid escapes and no
+// control characters. The structural index has already found the
+// closing quote at end.
+static bool valid_string(const char *s, size_t i, size_t end)
+{
+  while (i < end) {
+    unsigned char c = (unsigned char)s[i];
+    if (c < 0x20) {
+      return false;
+    }
+    if (c != '\\') {
+      i++;
+      continue;
+    }
+    switch (s[i + 1]) {
+      case '"': case '\\': case '/': case 'b': case 'f': case 'n':
+      case 'r': case 't':
+        i += 2;
+        break;
+      case 'u':
+        if (i + 6 > end || !is_hex_digit(s[i + 2]) ||
+            !is_hex_digit(s[i + 3]) || !is_hex_digit(s[i + 4]) ||
+            !is_hex_digit(s[i + 5])) {
+          return false;
+        }
+        i += 6;
+        break;
+      default:
+        return false;
+    }
+  }
+  return true;
+}
+
+static inline bool match_literal(const char *s, size_t len, size_t i,
+                                 const char *lit, size_t n)
+{
+  return i + n <= len && memcmp(s + i, lit, n) == 0 &&
+    is_delimiter(s, len, i + n);
+}
+
+typedef struct open_container
+{
+  size_t start;   // tape index of the start word
+  uint64_t count;
+} open_container;
+
+array_t *json_parse_tape(pony_ctx_t **ctx, const char *s, size_t len)
+{
+  if (len > UINT32_MAX) {
+    return NULL;
+  }
+
+  uint32_t *idx = encore_alloc(*ctx, (len + 1) * sizeof(uint32_t));
+  int64_t found = json_structural_index(s, len, idx);
+  if (found <= 0) {
+    return NULL;
+  }
+  size_t n = (size_t)found;
+
+  // Every value takes at most two words and is at least one
+  // structural; every end takes one word and one structural
+  uint64_t *tape = encore_alloc(*ctx, 2 * n * sizeof(uint64_t));
+  open_container *stack = encore_alloc(*ctx, n * sizeof(open_container));
+  size_t t = 0;
+  size_t depth = 0;
+  size_t i = 0;
+
+#define PEEK() (i < n ? s[idx[i]] : '\0')
+
+value:
+  if (i >= n) {
+    return NULL;
+  }
+  {
+    size_t p = idx[i];
+    switch (s[p]) {
+      case '{':
+      case '[':
+        stack[depth].start = t;
+        stack[depth].count = 0;
+        depth++;
+        tape[t++] = TAPE_WORD(s[p], 0);
+        tape[t++] = 0;
+        i++;
+        if (PEEK() == (s[p] == '{' ? '}' : ']')) {
+          goto close;
+        }
+        if (s[p] == '{') {
+          goto key;
+        }
+        goto value;
+      case '"':
+        // The closing quote is always the next structural
+        if (!valid_string(s, p + 1, idx[i + 1])) {
+          return NULL;
+        }
+        tape[t++] = TAPE_WORD('"', p + 1);
+        tape[t++] = idx[i + 1] - p - 1;
+        i += 2;
+        goto after_value;
+      case 't':
+        if (!match_literal(s, len, p, "true", 4)) {
+          return NULL;
+        }
+        tape[t++] = TAPE_WORD('t', p);
+        i++;
+        goto after_value;
+      case 'f':
+        if (!match_literal(s, len, p, "false", 5)) {
+          return NULL;
+        }
+        tape[t++] = TAPE_WORD('f', p);
+        i++;
+        goto after_value;
+      case 'n':
+        if (!match_literal(s, len, p, "null", 4)) {
+          return NULL;
+        }
+        tape[t++] = TAPE_WORD('n', p);
+        i++;
+        goto after_value;
+      default: {
+        size_t end = scan_number(s, len, p);
+        if (end == 0 || !is_delimiter(s, len, end)) {
+          return NULL;
+        }
+        tape[t++] = TAPE_WORD('0', p);
+        tape[t++] = end - p;
+        i++;
+        goto after_value;
+      }
+    }
+  }
+
+key:
+  if (PEEK() != '"' || !valid_string(s, idx[i] + 1, idx[i + 1])) {
+    return NULL;
+  }
+  tape[t++] = TAPE_WORD('"', idx[i] + 1);
+  tape[t++] = idx[i + 1] - idx[i] - 1;
+  i += 2;
+  if (PEEK() != ':') {
+    return NULL;
+  }
+  i++;
+  goto value;
+
+close:
+  {
+    open_container *c = &stack[--depth];
+    char open = JSON_TAPE_TAG(tape[c->start]);
+    tape[t] = TAPE_WORD(open == '{' ? '}' : ']', c->start);
+    t++;
+    tape[c->start] = TAPE_WORD(open, t);
+    tape[c->start + 1] = c->count;
+    i++;
+  }
+
+after_value:
+  if (depth == 0) {
+    if (i != n) {
+      return NULL;  // more after the value
+    }
+    array_t *result = array_mk(ctx, t, ENCORE_PRIMITIVE);
+    for (size_t w = 0; w < t; w++) {
+      array_set(result, w, (encore_arg_t){ .i = tape[w] });
+    }
+    return result;
+  }
+  {
+    open_container *c = &stack[depth - 1];
+    c->count++;
+    char open = JSON_TAPE_TAG(tape[c->start]);
+    char next = PEEK();
+    if (next == ',') {
+      i++;
+      if (open == '{') {
+        goto key;
+      }
+      goto value;
+    }
+    if (next == (open == '{' ? '}' : ']')) {
+      goto close;
+    }
+    return NULL;
+  }
+
+#undef PEEK
+}
@@ -0,0 +1,53 @@
+#ifndef __jsontape_h__
+#define __jsontape_h__
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <pony.h>
+#include <array.h>
+
+// A two-stage JSON parser. The first stage finds the structural
+// characters of the input (brackets, braces, colons, commas, quotes and
+// the first byte of every number and literal), 64 bytes at a time. The
+// second stage walks those positions only and records the document on
+// a tape: a flat array of 64-bit words, one or two per value, in
+// document order. Values are read off the tape on demand, so nothing is
+// allocated per value while parsing.
+//
+// Each tape word holds a tag (one of the characters below) in its top 8
+// bits and a 56-bit payload:
+//
+//   '"', '0'  string or number: the offset of its first byte in the
+//             input; the next word holds its length in bytes. Strings
+//             are stored as they appear between the quotes, with
+//             escape sequences left as they are.
+//   '{', '['  start of an object or array: the tape index just after
+//             its matching end; the next word holds its number of
+//             fields or elements. The fields of an object follow as
+//             alternating keys (strings) and values.
+//   '}', ']'  end of an object or array: the tape index of its start.
+//   't', 'f', 'n'  true, false and null: the offset in the input.
+
+#define JSON_TAPE_TAG(w) ((char)((w) >> 56))
+#define JSON_TAPE_PAYLOAD(w) ((w) & (((uint64_t)1 << 56) - 1))
+
+/** Find the structural characters of a JSON text
+ *
+ * @param s The text, of length \p len
+ * @param out Receives the offsets of the structural characters, in
+ * increasing order. It must have room for \p len + 1 entries.
+ * @return The number of offsets written, or -1 if a string is not
+ * terminated
+ */
+int64_t json_structural_index(const char *s, size_t len, uint32_t *out);
+
+/** Parse a JSON text onto a tape
+ *
+ * @param s The text, of length \p len, at most 4 GiB
+ * @return An array of uint holding the tape, or NULL if \p s is not
+ * a single valid JSON value surrounded by optional whitespace
+ */
+array_t *json_parse_tape(pony_ctx_t **ctx, const char *s, size_t len);
+
+#endif
@@ -137,10 +137,9 @@ static inline void trace_array_par(pony_ctx_t *ctx, par_t* obj){
       encore_trace_actor(ctx, val);
     }
   }else{
-    pony_trace_fn trace_fn = obj->rtype->trace;
     for(size_t i = 0; i<array_size(ar); i++){
       void* val = array_get(ar, i).p;
-      encore_trace_object(ctx, val, trace_fn);
+      encore_trace_known(ctx, val, obj->rtype);
     }
   }
 }
@@ -157,7 +156,7 @@ void party_trace(pony_ctx_t* ctx, void* p){
     switch(obj->tag){
     case EMPTY_PAR: break;
     case VALUE_PAR: {
-      encore_trace_object(ctx, obj->data.v.val.p, obj->rtype->trace);
+      encore_trace_known(ctx, obj->data.v.val.p, obj->rtype);
       break;
     }
     case FUTURE_PAR: {
@@ -3,7 +3,9 @@
 #include "actor.h"
 #include "../sched/scheduler.h"
 #include "../sched/cpu.h"
+#include "../sched/timeline.h"
 #include "../mem/pool.h"
+#include "profile.h"
 #include "../gc/cycle.h"
 #include "../gc/trace.h"
 #include "ponyassert.h"
@@ -110,7 +112,24 @@ static bool handle_message(pony_ctx_t** ctx, pony_actor_t* actor,
       }
 
       DTRACE3(ACTOR_MSG_RUN, (uintptr_t)(*ctx)->scheduler, (uintptr_t)actor, msg->id);
+      STATS_ADD(*ctx, messages, 1);
       if (!has_flag(actor, FLAG_SYSTEM)) {
+        // The message may be freed by the time the handler returns, and a
+        // handler that blocks returns here early: its time is the time
+        // until it first blocked.
+        uint32_t id = msg->id;
+        uint64_t sent = 0;
+        uint64_t start = 0;
+
+        if(ponyint_profiling)
+        {
+          uint64_t* stamp = ponyint_profile_stamp(msg);
+
+          if(stamp != NULL)
+            sent = *stamp;
+
+          start = ponyint_cpu_nanos();
+        }
 #ifndef LAZY_IMPL
         encore_actor_t *a = (encore_actor_t *)actor;
         getcontext(&a->uctx);
@@ -122,9 +141,21 @@ static bool handle_message(pony_ctx_t** ctx, pony_actor_t* actor,
             (void(*)(void))actor->type->dispatch, 3, ctx, a, msg);
         int ret = swapcontext(&a->home_uctx, &a->uctx);
         assert(ret == 0);
+
+        if(ponyint_profiling)
+          ponyint_profile_handled(actor->type, id, sent, start,
+            ponyint_cpu_nanos());
+
+        encore_flush_deferred(*ctx);
         return !has_flag(actor, FLAG_UNSCHEDULED);
 #else
         actor->type->dispatch(ctx, actor, msg);
+
+        if(ponyint_profiling)
+          ponyint_profile_handled(actor->type, id, sent, start,
+            ponyint_cpu_nanos());
+
+        encore_flush_deferred(*ctx);
 #endif
       } else {
         actor->type->dispatch((void*)*ctx, actor, msg);
@@ -144,6 +175,7 @@ static void try_gc(pony_ctx_t* ctx, pony_actor_t* actor)
     return;
 
   DTRACE1(GC_START, (uintptr_t)ctx->scheduler);
+  uint64_t start = ponyint_cpu_nanos();
 
   ponyint_gc_mark(ctx);
 
@@ -153,7 +185,13 @@ static void try_gc(pony_ctx_t* ctx, pony_actor_t* actor)
   ponyint_mark_done(ctx);
   ponyint_heap_endgc(&actor->heap);
 
+  STATS_ADD(ctx, gc_count, 1);
+  STATS_ADD(ctx, gc_pause_ns, ponyint_cpu_nanos() - start);
   DTRACE1(GC_END, (uintptr_t)ctx->scheduler);
+
+  if(ponyint_timeline_enabled)
+    ponyint_timeline_record(TIMELINE_GC, start, (uintptr_t)actor,
+      actor->type->id);
 }
 
 bool ponyint_actor_run(pony_ctx_t** ctx, pony_actor_t* actor, size_t batch)
@@ -377,10 +415,21 @@ PONY_API void ponyint_destroy(pony_actor_t* actor)
 
 PONY_API pony_msg_t* pony_alloc_msg(uint32_t index, uint32_t id)
 {
+  if(ponyint_profiling)
+    index = ponyint_profile_msg_index(index);
+
   pony_msg_t* msg = (pony_msg_t*)ponyint_pool_alloc(index);
   msg->index = index;
   msg->id = id;
 
+  if(ponyint_profiling)
+  {
+    uint64_t* stamp = ponyint_profile_stamp(msg);
+
+    if(stamp != NULL)
+      *stamp = 0;
+  }
+
   return msg;
 }
 
@@ -393,6 +442,9 @@ PONY_API void pony_sendv(pony_ctx_t* ctx, pony_actor_t* to, pony_msg_t* m)
 {
   DTRACE2(ACTOR_MSG_SEND, (uintptr_t)ctx->scheduler, m->id);
 
+  if(ponyint_profiling)
+    ponyint_profile_send(m);
+
   if(ponyint_messageq_push(&to->q, m))
   {
     if(!has_flag(to, FLAG_UNSCHEDULED))
@@ -400,6 +452,18 @@ PONY_API void pony_sendv(pony_ctx_t* ctx, pony_actor_t* to, pony_msg_t* m)
   }
 }
 
+bool ponyint_sendv_deferred(pony_ctx_t* ctx, pony_actor_t* to, pony_msg_t* m)
+{
+  DTRACE2(ACTOR_MSG_SEND, (uintptr_t)ctx->scheduler, m->id);
+
+  if(ponyint_profiling)
+    ponyint_profile_send(m);
+
+  // Same as pony_sendv, but if the receiver was idle the caller becomes
+  // responsible for scheduling it. Until then, nobody else will.
+  return ponyint_messageq_push(&to->q, m) && !has_flag(to, FLAG_UNSCHEDULED);
+}
+
 PONY_API void pony_send(pony_ctx_t* ctx, pony_actor_t* to, uint32_t id)
 {
   pony_msg_t* m = pony_alloc_msg(POOL_INDEX(sizeof(pony_msg_t)), id);
@@ -435,6 +499,7 @@ PONY_API void pony_continuation(pony_actor_t* self, pony_msg_t* m)
 PONY_API void* pony_alloc(pony_ctx_t* ctx, size_t size)
 {
   DTRACE2(HEAP_ALLOC, (uintptr_t)ctx->scheduler, size);
+  STATS_ADD(ctx, bytes_allocated, size);
 
   return ponyint_heap_alloc(ctx->current, &ctx->current->heap, size);
 }
@@ -442,6 +507,7 @@ PONY_API void* pony_alloc(pony_ctx_t* ctx, size_t size)
 PONY_API void* pony_alloc_small(pony_ctx_t* ctx, uint32_t sizeclass)
 {
   DTRACE2(HEAP_ALLOC, (uintptr_t)ctx->scheduler, HEAP_MIN << sizeclass);
+  STATS_ADD(ctx, bytes_allocated, HEAP_MIN << sizeclass);
 
   return ponyint_heap_alloc_small(ctx->current, &ctx->current->heap, sizeclass);
 }
@@ -449,6 +515,7 @@ PONY_API void* pony_alloc_small(pony_ctx_t* ctx, uint32_t sizeclass)
 PONY_API void* pony_alloc_large(pony_ctx_t* ctx, size_t size)
 {
   DTRACE2(HEAP_ALLOC, (uintptr_t)ctx->scheduler, size);
+  STATS_ADD(ctx, bytes_allocated, size);
 
   return ponyint_heap_alloc_large(ctx->current, &ctx->current->heap, size);
 }
@@ -456,6 +523,7 @@ PONY_API void* pony_alloc_large(pony_ctx_t* ctx, size_t size)
 PONY_API void* pony_realloc(pony_ctx_t* ctx, void* p, size_t size)
 {
   DTRACE2(HEAP_ALLOC, (uintptr_t)ctx->scheduler, size);
+  STATS_ADD(ctx, bytes_allocated, size);
 
   return ponyint_heap_realloc(ctx->current, &ctx->current->heap, p, size);
 }
@@ -463,6 +531,7 @@ PONY_API void* pony_realloc(pony_ctx_t* ctx, void* p, size_t size)
 PONY_API void* pony_alloc_final(pony_ctx_t* ctx, size_t size)
 {
   DTRACE2(HEAP_ALLOC, (uintptr_t)ctx->scheduler, size);
+  STATS_ADD(ctx, bytes_allocated, size);
 
   return ponyint_heap_alloc_final(ctx->current, &ctx->current->heap, size);
 }
@@ -470,6 +539,7 @@ PONY_API void* pony_alloc_final(pony_ctx_t* ctx, size_t size)
 void* pony_alloc_small_final(pony_ctx_t* ctx, uint32_t sizeclass)
 {
   DTRACE2(HEAP_ALLOC, (uintptr_t)ctx->scheduler, HEAP_MIN << sizeclass);
+  STATS_ADD(ctx, bytes_allocated, HEAP_MIN << sizeclass);
 
   return ponyint_heap_alloc_small_final(ctx->current, &ctx->current->heap,
     sizeclass);
@@ -478,6 +548,7 @@ void* pony_alloc_small_final(pony_ctx_t* ctx, uint32_t sizeclass)
 void* pony_alloc_large_final(pony_ctx_t* ctx, size_t size)
 {
   DTRACE2(HEAP_ALLOC, (uintptr_t)ctx->scheduler, size);
+  STATS_ADD(ctx, bytes_allocated, size);
 
   return ponyint_heap_alloc_large_final(ctx->current, &ctx->current->heap,
     size);
@@ -14,6 +14,7 @@
 
 PONY_EXTERN_C_BEGIN
 
+#define ACTORMSG_SCAN (UINT32_MAX - 7)
 #define ACTORMSG_BLOCK (UINT32_MAX - 6)
 #define ACTORMSG_UNBLOCK (UINT32_MAX - 5)
 #define ACTORMSG_ACQUIRE (UINT32_MAX - 4)
@@ -53,6 +54,8 @@ void ponyint_actor_setsystem(pony_actor_t* actor);
 
 void ponyint_actor_setnoblock(bool state);
 
+bool ponyint_sendv_deferred(pony_ctx_t* ctx, pony_actor_t* to, pony_msg_t* m);
+
 PONY_API void ponyint_destroy(pony_actor_t* actor);
 
 bool pony_system_actor(pony_actor_t *actor);
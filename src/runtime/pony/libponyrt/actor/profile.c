@@ -0,0 +1,329 @@
+#define PONY_WANT_ATOMIC_DEFS
+
+#include "profile.h"
+#include "../sched/cpu.h"
+#include "../mem/pool.h"
+#include <stdlib.h>
+#include <string.h>
+
+// Values below 8 get a bucket each. Above that, every power of two 2^e is
+// split into 8 buckets by the 3 bits below its top bit.
+#define SUB_BITS 3
+#define SUB_COUNT (1 << SUB_BITS)
+#define BUCKETS ((64 - SUB_BITS + 1) * SUB_COUNT)
+
+#define TABLE_MIN 64
+
+typedef struct histogram_t
+{
+  uint64_t max;
+  uint64_t total;
+  uint64_t counts[BUCKETS];
+} histogram_t;
+
+typedef struct profile_entry_t
+{
+  pony_type_t* type;
+  uint32_t id;
+  uint64_t count;
+  uint64_t waited;
+  histogram_t wait;
+  histogram_t run;
+} profile_entry_t;
+
+typedef struct profile_table_t
+{
+  profile_entry_t** slots;
+  size_t size;
+  size_t count;
+  struct profile_table_t* next;
+} profile_table_t;
+
+bool ponyint_profiling;
+
+static __pony_thread_local profile_table_t* this_table;
+static PONY_ATOMIC(profile_table_t*) tables;
+
+void ponyint_profile_enable()
+{
+  ponyint_profiling = true;
+}
+
+void ponyint_profile_send(pony_msg_t* m)
+{
+  uint64_t* stamp = ponyint_profile_stamp(m);
+
+  if(stamp != NULL)
+    *stamp = ponyint_cpu_nanos();
+}
+
+static size_t bucket_of(uint64_t v)
+{
+  if(v < SUB_COUNT)
+    return (size_t)v;
+
+  size_t e = 63 - (size_t)__pony_clzl(v);
+  return ((e - SUB_BITS + 1) << SUB_BITS) +
+    (size_t)((v >> (e - SUB_BITS)) & (SUB_COUNT - 1));
+}
+
+// The largest value that falls in bucket b.
+static uint64_t bucket_limit(size_t b)
+{
+  if(b < SUB_COUNT)
+    return b;
+
+  size_t e = (b >> SUB_BITS) + SUB_BITS - 1;
+  uint64_t low = (uint64_t)(SUB_COUNT + (b & (SUB_COUNT - 1)))
+    << (e - SUB_BITS);
+  return low + ((uint64_t)1 << (e - SUB_BITS)) - 1;
+}
+
+static void record(histogram_t* h, uint64_t v)
+{
+  h->counts[bucket_of(v)]++;
+  h->total += v;
+
+  if(v > h->max)
+    h->max = v;
+}
+
+static void merge(histogram_t* into, histogram_t* from)
+{
+  for(size_t i = 0; i < BUCKETS; i++)
+    into->counts[i] += from->counts[i];
+
+  into->total += from->total;
+
+  if(from->max > into->max)
+    into->max = from->max;
+}
+
+// The value below which a fraction p of the n recorded values lie, to the
+// precision of the buckets.
+static uint64_t percentile(histogram_t* h, uint64_t n, double p)
+{
+  if(n == 0)
+    return 0;
+
+  uint64_t rank = (uint64_t)(p * (double)n);
+  uint64_t seen = 0;
+
+  if(rank >= n)
+    rank = n - 1;
+
+  for(size_t i = 0; i < BUCKETS; i++)
+  {
+    seen += h->counts[i];
+
+    if(seen > rank)
+    {
+      uint64_t limit = bucket_limit(i);
+      return limit < h->max ? limit : h->max;
+    }
+  }
+
+  return h->max;
+}
+
+static size_t slot_of(pony_type_t* type, uint32_t id, size_t size)
+{
+  uint64_t key = (uint64_t)(uintptr_t)type ^ ((uint64_t)id << 32) ^ id;
+  key *= 0x9E3779B97F4A7C15ull;
+  return (size_t)(key >> 32) & (size - 1);
+}
+
+static profile_entry_t** find_slot(profile_entry_t** slots, size_t size,
+  pony_type_t* type, uint32_t id)
+{
+  size_t i = slot_of(type, id, size);
+
+  while((slots[i] != NULL) &&
+    ((slots[i]->type != type) || (slots[i]->id != id)))
+    i = (i + 1) & (size - 1);
+
+  return &slots[i];
+}
+
+static void grow(profile_table_t* t)
+{
+  size_t size = t->size * 2;
+  profile_entry_t** slots =
+    (profile_entry_t**)ponyint_pool_alloc_size(size * sizeof(profile_entry_t*));
+  memset(slots, 0, size * sizeof(profile_entry_t*));
+
+  for(size_t i = 0; i < t->size; i++)
+  {
+    profile_entry_t* e = t->slots[i];
+
+    if(e != NULL)
+      *find_slot(slots, size, e->type, e->id) = e;
+  }
+
+  ponyint_pool_free_size(t->size * sizeof(profile_entry_t*), t->slots);
+  t->slots = slots;
+  t->size = size;
+}
+
+static profile_table_t* get_table()
+{
+  profile_table_t* t = this_table;
+
+  if(t != NULL)
+    return t;
+
+  t = (profile_table_t*)ponyint_pool_alloc_size(sizeof(profile_table_t));
+  t->size = TABLE_MIN;
+  t->count = 0;
+  t->slots =
+    (profile_entry_t**)ponyint_pool_alloc_size(t->size * sizeof(profile_entry_t*));
+  memset(t->slots, 0, t->size * sizeof(profile_entry_t*));
+
+  // Tables are only ever added, and only read once all threads are done.
+  t->next = atomic_load_explicit(&tables, memory_order_relaxed);
+
+  while(!atomic_compare_exchange_weak_explicit(&tables, &t->next, t,
+    memory_order_release, memory_order_relaxed))
+    ;
+
+  this_table = t;
+  return t;
+}
+
+static profile_entry_t* new_entry(pony_type_t* type, uint32_t id)
+{
+  profile_entry_t* e =
+    (profile_entry_t*)ponyint_pool_alloc_size(sizeof(profile_entry_t));
+  memset(e, 0, sizeof(profile_entry_t));
+  e->type = type;
+  e->id = id;
+  return e;
+}
+
+void ponyint_profile_handled(pony_type_t* type, uint32_t id, uint64_t sent,
+  uint64_t start, uint64_t end)
+{
+  profile_table_t* t = get_table();
+  profile_entry_t** slot = find_slot(t->slots, t->size, type, id);
+
+  if(*slot == NULL)
+  {
+    if((t->count + 1) * 2 > t->size)
+    {
+      grow(t);
+      slot = find_slot(t->slots, t->size, type, id);
+    }
+
+    *slot = new_entry(type, id);
+    t->count++;
+  }
+
+  profile_entry_t* e = *slot;
+  e->count++;
+
+  // The clock is per process, but a stamp taken on another core may still
+  // be a little ahead of this one.
+  if(sent != 0)
+  {
+    record(&e->wait, start > sent ? start - sent : 0);
+    e->waited++;
+  }
+
+  record(&e->run, end - start);
+}
+
+static int busiest_first(const void* a, const void* b)
+{
+  const profile_entry_t* x = *(profile_entry_t* const*)a;
+  const profile_entry_t* y = *(profile_entry_t* const*)b;
+
+  if(x->run.total != y->run.total)
+    return x->run.total < y->run.total ? 1 : -1;
+
+  return x->id < y->id ? -1 : (x->id > y->id);
+}
+
+void ponyint_profile_report(FILE* fp,
+  const char* (*name)(pony_type_t* type, uint32_t id))
+{
+  profile_table_t* first = atomic_load_explicit(&tables, memory_order_acquire);
+  size_t count = 0;
+
+  for(profile_table_t* t = first; t != NULL; t = t->next)
+    count += t->count;
+
+  if(count == 0)
+    return;
+
+  // Merge the tables of all threads into one.
+  profile_table_t all;
+  all.size = TABLE_MIN;
+  all.count = 0;
+
+  while(all.size < count * 2)
+    all.size *= 2;
+
+  all.slots = (profile_entry_t**)calloc(all.size, sizeof(profile_entry_t*));
+  profile_entry_t** list =
+    (profile_entry_t**)malloc(count * sizeof(profile_entry_t*));
+
+  for(profile_table_t* t = first; t != NULL; t = t->next)
+  {
+    for(size_t i = 0; i < t->size; i++)
+    {
+      profile_entry_t* e = t->slots[i];
+
+      if(e == NULL)
+        continue;
+
+      profile_entry_t** slot = find_slot(all.slots, all.size, e->type, e->id);
+
+      if(*slot == NULL)
+      {
+        *slot = (profile_entry_t*)calloc(1, sizeof(profile_entry_t));
+        (*slot)->type = e->type;
+        (*slot)->id = e->id;
+        list[all.count++] = *slot;
+      }
+
+      (*slot)->count += e->count;
+      (*slot)->waited += e->waited;
+      merge(&(*slot)->wait, &e->wait);
+      merge(&(*slot)->run, &e->run);
+    }
+  }
+
+  qsort(list, all.count, sizeof(profile_entry_t*), busiest_first);
+
+  fprintf(fp, "encore message profile (ns)\n");
+  fprintf(fp, "%-40s %10s %10s %10s %10s %10s %10s %10s\n", "message",
+    "count", "wait p50", "wait p99", "wait max", "run p50", "run p99",
+    "run max");
+
+  for(size_t i = 0; i < all.count; i++)
+  {
+    profile_entry_t* e = list[i];
+    const char* s = name != NULL ? name(e->type, e->id) : NULL;
+    char unnamed[32];
+
+    if(s == NULL)
+    {
+      snprintf(unnamed, sizeof(unnamed), "message %u", e->id);
+      s = unnamed;
+    }
+
+    fprintf(fp, "%-40s %10llu %10llu %10llu %10llu %10llu %10llu %10llu\n", s,
+      (unsigned long long)e->count,
+      (unsigned long long)percentile(&e->wait, e->waited, 0.50),
+      (unsigned long long)percentile(&e->wait, e->waited, 0.99),
+      (unsigned long long)e->wait.max,
+      (unsigned long long)percentile(&e->run, e->count, 0.50),
+      (unsigned long long)percentile(&e->run, e->count, 0.99),
+      (unsigned long long)e->run.max);
+
+    free(e);
+  }
+
+  free(list);
+  free(all.slots);
+}
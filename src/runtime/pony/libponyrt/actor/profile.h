@@ -0,0 +1,69 @@
+#ifndef actor_profile_h
+#define actor_profile_h
+
+#include <pony.h>
+#include <platform.h>
+#include <stdio.h>
+#include "../mem/pool.h"
+
+PONY_EXTERN_C_BEGIN
+
+/** Message profiling.
+ *
+ * When enabled, every message is stamped when it is sent, and every
+ * application message is timed when it is handled. Each thread keeps
+ * log-linear histograms (8 sub-buckets per power of two, so values are
+ * within 12.5%) of the time messages waited in a queue and the time their
+ * handlers ran, keyed by receiver type and message id. The report merges
+ * the histograms of all threads.
+ *
+ * The send time is kept in the last 8 bytes of the message's pool block,
+ * which is taken one size class larger while profiling. Messages of the
+ * two largest size classes are therefore not given a wait time.
+ *
+ * Profiling must be enabled before any message is allocated, and costs a
+ * predictable branch per message when it is not.
+ */
+extern bool ponyint_profiling;
+
+void ponyint_profile_enable();
+
+/// The pool index to allocate a message of pool index \p index with.
+static inline uint32_t ponyint_profile_msg_index(uint32_t index)
+{
+  return index + 1 < POOL_COUNT ? index + 1 : index;
+}
+
+/// Where the send time of \p m is kept, or NULL if it has none.
+static inline uint64_t* ponyint_profile_stamp(pony_msg_t* m)
+{
+  if(m->index + 1 >= POOL_COUNT)
+    return NULL;
+
+  return (uint64_t*)((char*)m + ((size_t)POOL_MIN << m->index)) - 1;
+}
+
+/// Record that a message was sent now.
+void ponyint_profile_send(pony_msg_t* m);
+
+/** Record a message with id \p id handled by an actor of type \p type.
+ *
+ * \p sent is the stamp the message had, or 0 if it had none, and the
+ * handler ran from \p start to \p end. The caller reads the stamp before
+ * dispatching, as the message may be gone once the handler returns.
+ */
+void ponyint_profile_handled(pony_type_t* type, uint32_t id, uint64_t sent,
+  uint64_t start, uint64_t end);
+
+/** Print one line per (type, message id) handled, busiest first.
+ *
+ * \p name gives a name for a message id sent to an actor of the given
+ * type, or NULL if it has none. Message ids are only unique within a type.
+ * This must only be called once all scheduler threads have stopped.
+ */
+void ponyint_profile_report(FILE* fp,
+  const char* (*name)(pony_type_t* type, uint32_t id));
+
+PONY_EXTERN_C_END
+
+#endif
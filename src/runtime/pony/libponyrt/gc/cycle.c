@@ -26,6 +26,17 @@ typedef struct block_msg_t
   deltamap_t* delta;
 } block_msg_t;
 
+// A message that arrived while a detection was running, kept until it is
+// done. The message itself is freed once it has been handled.
+typedef struct pending_t
+{
+  uint32_t id;
+  pony_actor_t* actor;
+  size_t rc;
+  deltamap_t* delta;
+  struct pending_t* next;
+} pending_t;
+
 typedef struct view_t view_t;
 typedef struct perceived_t perceived_t;
 
@@ -64,6 +75,13 @@ enum
   COLOR_WHITE
 } ponyint_color_t;
 
+enum
+{
+  SCAN_GREY,
+  SCAN_WHITE,
+  SCAN_COLLECT
+} ponyint_scan_t;
+
 struct view_t
 {
   pony_actor_t* actor;
@@ -71,6 +89,7 @@ struct view_t
   uint32_t view_rc;
   bool blocked;
   bool deferred;
+  bool contacted;
   uint8_t color;
   viewrefmap_t map;
   deltamap_t* delta;
@@ -149,14 +168,37 @@ typedef struct detector_t
   size_t conf_group;
   size_t next_deferred;
   size_t since_deferred;
+  size_t budget;
 
   viewmap_t views;
   viewmap_t deferred;
   perceivedmap_t perceived;
 
+  // The detection in progress, if scan_root is not NULL. It pushes and pops
+  // at most budget references per message and resumes on an ACTORMSG_SCAN
+  // sent to itself. Until it is done, and the pending list is empty again,
+  // other messages are kept in the pending list, so that the views don't
+  // change under it.
+  view_t* scan_root;
+  viewref_t scan_head;
+  viewref_t black_head;
+  viewrefstack_t* scan_stack;
+  viewrefstack_t* black_stack;
+  perceived_t* scan_per;
+  int scan_count;
+  int black_count;
+  uint8_t scan_phase;
+  bool scan_deferred;
+  bool deferred_found;
+  size_t deferred_index;
+
+  pending_t* pending;
+  pending_t* pending_tail;
+
   size_t attempted;
   size_t detected;
   size_t collected;
+  size_t orphaned;
 
   size_t created;
   size_t destroyed;
@@ -273,25 +315,41 @@ static bool mark_grey(detector_t* d, view_t* view, size_t rc)
   return true;
 }
 
-static void scan_grey(detector_t* d, view_t* view, size_t rc)
+static viewrefstack_t* push_children(viewrefstack_t* stack, view_t* view,
+  size_t* budget)
+{
+  size_t i = HASHMAP_BEGIN;
+  size_t count = 0;
+  viewref_t* child;
+
+  while((child = ponyint_viewrefmap_next(&view->map, &i)) != NULL)
+  {
+    stack = ponyint_viewrefstack_push(stack, child);
+    count++;
+  }
+
+  // a view with many references can't be split, but uses up the budget
+  *budget = (count < *budget) ? (*budget - count) : 0;
+  return stack;
+}
+
+static bool scan_grey(detector_t* d, size_t* budget)
 {
   viewref_t* ref;
-  viewref_t head = {view, rc};
-  viewrefstack_t* stack = ponyint_viewrefstack_push(NULL, &head);
 
-  while(stack != NULL)
+  while(d->scan_stack != NULL)
   {
-    stack = ponyint_viewrefstack_pop(stack, &ref);
+    if(*budget == 0)
+      return false;
 
-    if(mark_grey(d, ref->view, ref->rc))
-    {
-      size_t i = HASHMAP_BEGIN;
-      viewref_t* child;
+    (*budget)--;
+    d->scan_stack = ponyint_viewrefstack_pop(d->scan_stack, &ref);
 
-      while((child = ponyint_viewrefmap_next(&ref->view->map, &i)) != NULL)
-        stack = ponyint_viewrefstack_push(stack, child);
-    }
+    if(mark_grey(d, ref->view, ref->rc))
+      d->scan_stack = push_children(d->scan_stack, ref->view, budget);
   }
+
+  return true;
 }
 
 static bool mark_black(view_t* view, size_t rc, int* count)
@@ -315,32 +373,27 @@ static bool mark_black(view_t* view, size_t rc, int* count)
   return true;
 }
 
-static int scan_black(view_t* view, size_t rc)
+static bool scan_black(detector_t* d, size_t* budget)
 {
-  // return the count of white nodes colored black
-  int count = 0;
+  // keep a count of white nodes colored black
   viewref_t* ref;
-  viewref_t head = {view, rc};
-  viewrefstack_t* stack = ponyint_viewrefstack_push(NULL, &head);
 
-  while(stack != NULL)
+  while(d->black_stack != NULL)
   {
-    stack = ponyint_viewrefstack_pop(stack, &ref);
+    if(*budget == 0)
+      return false;
 
-    if(mark_black(ref->view, ref->rc, &count))
-    {
-      size_t i = HASHMAP_BEGIN;
-      viewref_t* child;
+    (*budget)--;
+    d->black_stack = ponyint_viewrefstack_pop(d->black_stack, &ref);
 
-      while((child = ponyint_viewrefmap_next(&ref->view->map, &i)) != NULL)
-        stack = ponyint_viewrefstack_push(stack, child);
-    }
+    if(mark_black(ref->view, ref->rc, &d->black_count))
+      d->black_stack = push_children(d->black_stack, ref->view, budget);
   }
 
-  return count;
+  return true;
 }
 
-static bool mark_white(view_t* view, int* count)
+static bool mark_white(detector_t* d, view_t* view)
 {
   if(view->color != COLOR_GREY)
     return false;
@@ -349,41 +402,45 @@ static bool mark_white(view_t* view, int* count)
 
   if(view->rc > 0)
   {
-    // keep a count of grey nodes colored white minus white nodes colored black
-    *count = *count - scan_black(view, 0);
+    // the view is live, scan it black before going on
+    d->black_head.view = view;
+    d->black_head.rc = 0;
+    d->black_stack = ponyint_viewrefstack_push(NULL, &d->black_head);
     return false;
   }
 
   pony_assert(view->perceived == NULL);
 
   view->color = COLOR_WHITE;
-  *count = *count + 1;
+  d->scan_count++;
   return true;
 }
 
-static int scan_white(view_t* view)
+static bool scan_white(detector_t* d, size_t* budget)
 {
-  // return count of white nodes
-  int count = 0;
+  // keep a count of grey nodes colored white minus white nodes colored black
   viewref_t* ref;
-  viewref_t head = {view, 0};
-  viewrefstack_t* stack = ponyint_viewrefstack_push(NULL, &head);
 
-  while(stack != NULL)
+  while(true)
   {
-    stack = ponyint_viewrefstack_pop(stack, &ref);
+    if(!scan_black(d, budget))
+      return false;
 
-    if(mark_white(ref->view, &count))
-    {
-      size_t i = HASHMAP_BEGIN;
-      viewref_t* child;
+    d->scan_count -= d->black_count;
+    d->black_count = 0;
 
-      while((child = ponyint_viewrefmap_next(&ref->view->map, &i)) != NULL)
-        stack = ponyint_viewrefstack_push(stack, child);
-    }
-  }
+    if(d->scan_stack == NULL)
+      return true;
 
-  return count;
+    if(*budget == 0)
+      return false;
+
+    (*budget)--;
+    d->scan_stack = ponyint_viewrefstack_pop(d->scan_stack, &ref);
+
+    if(mark_white(d, ref->view))
+      d->scan_stack = push_children(d->scan_stack, ref->view, budget);
+  }
 }
 
 static bool collect_view(perceived_t* per, view_t* view, size_t rc, int* count)
@@ -400,29 +457,24 @@ static bool collect_view(perceived_t* per, view_t* view, size_t rc, int* count)
   return mark_black(view, rc, count);
 }
 
-static int collect_white(perceived_t* per, view_t* view, size_t rc)
+static bool collect_white(detector_t* d, size_t* budget)
 {
-  // return a count of white nodes colored black
-  int count = 0;
+  // keep a count of white nodes colored black
   viewref_t* ref;
-  viewref_t head = {view, rc};
-  viewrefstack_t* stack = ponyint_viewrefstack_push(NULL, &head);
 
-  while(stack != NULL)
+  while(d->scan_stack != NULL)
   {
-    stack = ponyint_viewrefstack_pop(stack, &ref);
+    if(*budget == 0)
+      return false;
 
-    if(collect_view(per, ref->view, ref->rc, &count))
-    {
-      size_t i = HASHMAP_BEGIN;
-      viewref_t* child;
+    (*budget)--;
+    d->scan_stack = ponyint_viewrefstack_pop(d->scan_stack, &ref);
 
-      while((child = ponyint_viewrefmap_next(&ref->view->map, &i)) != NULL)
-        stack = ponyint_viewrefstack_push(stack, child);
-    }
+    if(collect_view(d->scan_per, ref->view, ref->rc, &d->black_count))
+      d->scan_stack = push_children(d->scan_stack, ref->view, budget);
   }
 
-  return count;
+  return true;
 }
 
 static void send_conf(pony_ctx_t* ctx, detector_t* d, perceived_t* per)
@@ -434,6 +486,7 @@ static void send_conf(pony_ctx_t* ctx, detector_t* d, perceived_t* per)
   while((view = ponyint_viewmap_next(&per->map, &i)) != NULL)
   {
     pony_sendi(ctx, view->actor, ACTORMSG_CONF, per->token);
+    view->contacted = true;
     count++;
 
     if(count == d->conf_group)
@@ -443,67 +496,111 @@ static void send_conf(pony_ctx_t* ctx, detector_t* d, perceived_t* per)
   per->last_conf = i;
 }
 
-static bool detect(pony_ctx_t* ctx, detector_t* d, view_t* view)
+static void detect(detector_t* d, view_t* view, bool from_deferred)
 {
+  pony_assert(d->scan_root == NULL);
   pony_assert(view->perceived == NULL);
 
-  scan_grey(d, view, 0);
-  int count = scan_white(view);
-  pony_assert(count >= 0);
+  d->scan_root = view;
+  d->scan_phase = SCAN_GREY;
+  d->scan_deferred = from_deferred;
+  d->scan_count = 0;
+  d->black_count = 0;
+  d->scan_head.view = view;
+  d->scan_head.rc = 0;
+  d->scan_stack = ponyint_viewrefstack_push(NULL, &d->scan_head);
+}
 
-  if(count == 0)
-    return false;
+// Carry on with the detection in progress, following at most *budget
+// references. Returns false if the budget runs out before it is done.
+static bool detect_step(pony_ctx_t* ctx, detector_t* d, size_t* budget,
+  bool* found)
+{
+  switch(d->scan_phase)
+  {
+    case SCAN_GREY:
+    {
+      if(!scan_grey(d, budget))
+        return false;
 
-  d->detected++;
+      d->scan_phase = SCAN_WHITE;
+      d->scan_stack = ponyint_viewrefstack_push(NULL, &d->scan_head);
+    } // fallthrough
 
-  perceived_t* per = (perceived_t*)POOL_ALLOC(perceived_t);
-  per->token = d->next_token++;
-  per->ack = 0;
-  per->last_conf = HASHMAP_BEGIN;
-  ponyint_viewmap_init(&per->map, count);
-  ponyint_perceivedmap_put(&d->perceived, per);
+    case SCAN_WHITE:
+    {
+      if(!scan_white(d, budget))
+        return false;
 
-  int count2 = collect_white(per, view, 0);
+      pony_assert(d->scan_count >= 0);
 
-  (void)count2;
-  pony_assert(count2 == count);
-  pony_assert(ponyint_viewmap_size(&per->map) == (size_t)count);
+      if(d->scan_count == 0)
+      {
+        *found = false;
+        return true;
+      }
 
-  send_conf(ctx, d, per);
-  return true;
-}
+      d->detected++;
 
-static void deferred(pony_ctx_t* ctx, detector_t* d)
-{
-  d->since_deferred++;
+      perceived_t* per = (perceived_t*)POOL_ALLOC(perceived_t);
+      per->token = d->next_token++;
+      per->ack = 0;
+      per->last_conf = HASHMAP_BEGIN;
+      ponyint_viewmap_init(&per->map, d->scan_count);
+      ponyint_perceivedmap_put(&d->perceived, per);
 
-  if(d->since_deferred < d->next_deferred)
-    return;
+      d->scan_per = per;
+      d->scan_phase = SCAN_COLLECT;
+      d->scan_stack = ponyint_viewrefstack_push(NULL, &d->scan_head);
+    } // fallthrough
 
-  d->attempted++;
+    case SCAN_COLLECT:
+    {
+      if(!collect_white(d, budget))
+        return false;
 
-  bool found = false;
-  size_t i = HASHMAP_BEGIN;
-  view_t* view;
+      pony_assert(d->black_count == d->scan_count);
+      pony_assert(ponyint_viewmap_size(&d->scan_per->map) ==
+        (size_t)d->scan_count);
 
-  while((view = ponyint_viewmap_next(&d->deferred, &i)) != NULL)
-  {
-    pony_assert(view->deferred == true);
-    ponyint_viewmap_removeindex(&d->deferred, i);
+      send_conf(ctx, d, d->scan_per);
+      d->scan_per = NULL;
+      *found = true;
+      return true;
+    }
 
-    // always scan again from same index because robin hood hashmap
-    // will shift delete items
-    i--;
+    default: {}
+  }
 
-    view->deferred = false;
+  pony_assert(0);
+  return true;
+}
 
-    if(!detect(ctx, d, view))
-      break;
+// Start a detection from the next view in the deferred set. Returns false
+// if the set is empty.
+static bool next_deferred(detector_t* d)
+{
+  size_t i = d->deferred_index;
+  view_t* view = ponyint_viewmap_next(&d->deferred, &i);
 
-    found = true;
-  }
+  if(view == NULL)
+    return false;
+
+  pony_assert(view->deferred == true);
+  ponyint_viewmap_removeindex(&d->deferred, i);
 
-  if(found)
+  // always scan again from same index because robin hood hashmap
+  // will shift delete items
+  d->deferred_index = i - 1;
+  view->deferred = false;
+
+  detect(d, view, true);
+  return true;
+}
+
+static void end_deferred(detector_t* d)
+{
+  if(d->deferred_found)
   {
     if(d->next_deferred > d->min_deferred)
       d->next_deferred >>= 1;
@@ -515,6 +612,23 @@ static void deferred(pony_ctx_t* ctx, detector_t* d)
   }
 }
 
+static void deferred(detector_t* d)
+{
+  d->since_deferred++;
+
+  if(d->since_deferred < d->next_deferred)
+    return;
+
+  d->attempted++;
+
+  // detect from each deferred view in turn, until one isn't in a cycle
+  d->deferred_found = false;
+  d->deferred_index = HASHMAP_BEGIN;
+
+  if(!next_deferred(d))
+    end_deferred(d);
+}
+
 static void expire(detector_t* d, view_t* view)
 {
   perceived_t* per = view->perceived;
@@ -572,12 +686,40 @@ static void collect(pony_ctx_t* ctx, detector_t* d, perceived_t* per)
   }
 
   d->destroyed += ponyint_viewmap_size(&per->map);
+  STATS_ADD(ctx, cd_collected, ponyint_viewmap_size(&per->map));
 
   // free the perceived cycle
   perceived_free(per);
   d->collected++;
 }
 
+static void collect_orphan(pony_ctx_t* ctx, detector_t* d, view_t* view)
+{
+  pony_actor_t* actor = view->actor;
+
+  ponyint_actor_setpendingdestroy(actor);
+  ponyint_actor_final(ctx, actor);
+  ponyint_actor_sendrelease(ctx, actor);
+  ponyint_actor_destroy(actor);
+
+  // other views may still refer to this one until their deltas arrive
+  ponyint_viewmap_remove(&d->views, view);
+  view->actor = NULL;
+  view->blocked = false;
+
+  if(view->delta != NULL)
+  {
+    ponyint_deltamap_free(view->delta);
+    view->delta = NULL;
+  }
+
+  view_free(view);
+
+  d->destroyed++;
+  d->orphaned++;
+  STATS_ADD(ctx, cd_collected, 1);
+}
+
 static void block(pony_ctx_t* ctx, detector_t* d, pony_actor_t* actor,
   size_t rc, deltamap_t* map)
 {
@@ -608,8 +750,17 @@ static void block(pony_ctx_t* ctx, detector_t* d, pony_actor_t* actor,
       view->deferred = false;
     }
 
+    // Nothing can reach an actor with no references to it. If we have never
+    // sent it a CONF, nothing can be in its queue either, so there is no
+    // need to look for a cycle and confirm it.
+    if(!view->contacted)
+    {
+      collect_orphan(ctx, d, view);
+      return;
+    }
+
     // detect from this actor, bypassing deferral
-    detect(ctx, d, view);
+    detect(d, view, false);
   } else {
     // add to the deferred set
     if(!view->deferred)
@@ -619,7 +770,7 @@ static void block(pony_ctx_t* ctx, detector_t* d, pony_actor_t* actor,
     }
 
     // look for cycles
-    deferred(ctx, d);
+    deferred(d);
   }
 }
 
@@ -647,8 +798,9 @@ static void unblock(detector_t* d, pony_actor_t* actor)
   expire(d, view);
 }
 
-static void ack(pony_ctx_t* ctx, detector_t* d, size_t token)
+static bool ack(pony_ctx_t* ctx, detector_t* d, size_t token)
 {
+  // return true if a cycle was collected
   perceived_t key;
   key.token = token;
   size_t index = HASHMAP_UNKNOWN;
@@ -656,18 +808,143 @@ static void ack(pony_ctx_t* ctx, detector_t* d, size_t token)
   perceived_t* per = ponyint_perceivedmap_get(&d->perceived, &key, &index);
 
   if(per == NULL)
-    return;
+    return false;
 
   per->ack++;
 
   if(per->ack == ponyint_viewmap_size(&per->map))
   {
     collect(ctx, d, per);
-    return;
+    return true;
   }
 
   if((per->ack & (d->conf_group - 1)) == 0)
     send_conf(ctx, d, per);
+
+  return false;
+}
+
+static void defer_msg(detector_t* d, pony_msg_t* msg)
+{
+  pending_t* p = (pending_t*)POOL_ALLOC(pending_t);
+  memset(p, 0, sizeof(pending_t));
+  p->id = msg->id;
+
+  switch(msg->id)
+  {
+    case ACTORMSG_BLOCK:
+    {
+      block_msg_t* m = (block_msg_t*)msg;
+      p->actor = m->actor;
+      p->rc = m->rc;
+      p->delta = m->delta;
+      break;
+    }
+
+    case ACTORMSG_UNBLOCK:
+    {
+      pony_msgp_t* m = (pony_msgp_t*)msg;
+      p->actor = (pony_actor_t*)m->p;
+      break;
+    }
+
+    case ACTORMSG_ACK:
+    {
+      pony_msgi_t* m = (pony_msgi_t*)msg;
+      p->rc = m->i;
+      break;
+    }
+
+    default: {}
+  }
+
+  if(d->pending_tail != NULL)
+    d->pending_tail->next = p;
+  else
+    d->pending = p;
+
+  d->pending_tail = p;
+}
+
+static void handle_pending(pony_ctx_t* ctx, detector_t* d, size_t* budget)
+{
+  pending_t* p = d->pending;
+  d->pending = p->next;
+
+  if(d->pending == NULL)
+    d->pending_tail = NULL;
+
+  switch(p->id)
+  {
+    case ACTORMSG_BLOCK:
+      block(ctx, d, p->actor, p->rc, p->delta);
+      break;
+
+    case ACTORMSG_UNBLOCK:
+      unblock(d, p->actor);
+      break;
+
+    case ACTORMSG_ACK:
+    {
+      // destroying the actors of a cycle costs far more than following
+      // references, so stop after collecting one
+      if(ack(ctx, d, p->rc))
+        *budget = 1;
+      break;
+    }
+
+    default: {}
+  }
+
+  POOL_FREE(pending_t, p);
+  (*budget)--;
+}
+
+// Run the detection in progress, and any that follow it, until the budget
+// runs out. Messages that were kept while a detection ran are handled in
+// between, in the order they arrived, and count against the budget too.
+static void scan(pony_ctx_t* ctx, detector_t* d)
+{
+  size_t budget = d->budget;
+
+  while(true)
+  {
+    bool found = false;
+
+    if(d->scan_root == NULL)
+    {
+      if(d->pending == NULL)
+        return;
+
+      if(budget > 0)
+      {
+        handle_pending(ctx, d, &budget);
+        continue;
+      }
+    } else if(detect_step(ctx, d, &budget, &found)) {
+      d->scan_root = NULL;
+
+      if(d->scan_deferred)
+      {
+        if(found)
+        {
+          d->deferred_found = true;
+
+          if(next_deferred(d))
+            continue;
+        }
+
+        end_deferred(d);
+      }
+
+      continue;
+    }
+
+    // give the scheduler thread back, and carry on later
+    STATS_ADD(ctx, cd_yields, 1);
+    pony_send(ctx, cycle_detector, ACTORMSG_SCAN);
+    return;
+  }
 }
 
 static void final(pony_ctx_t* ctx, pony_actor_t* self)
@@ -696,6 +973,40 @@ static void final(pony_ctx_t* ctx, pony_actor_t* self)
   } while(!ponyint_messageq_markempty(&self->q));
 
   detector_t* d = (detector_t*)self;
+
+  // Do the same for block messages kept for a detection that never finished
+  while(d->pending != NULL)
+  {
+    pending_t* p = d->pending;
+    d->pending = p->next;
+
+    if(p->id == ACTORMSG_BLOCK)
+    {
+      if(p->delta != NULL)
+        ponyint_deltamap_free(p->delta);
+
+      if(!ponyint_actor_pendingdestroy(p->actor))
+      {
+        ponyint_actor_setpendingdestroy(p->actor);
+        ponyint_actor_final(ctx, p->actor);
+      }
+    }
+
+    POOL_FREE(pending_t, p);
+  }
+
+  d->pending_tail = NULL;
+
+  viewref_t* ref;
+
+  while(d->scan_stack != NULL)
+    d->scan_stack = ponyint_viewrefstack_pop(d->scan_stack, &ref);
+
+  while(d->black_stack != NULL)
+    d->black_stack = ponyint_viewrefstack_pop(d->black_stack, &ref);
+
+  d->scan_root = NULL;
+
   size_t i = HASHMAP_BEGIN;
   view_t* view;
 
@@ -784,11 +1095,16 @@ static void check_view(detector_t* d, view_t* view)
     return;
   }
 
-  scan_grey(d, view, 0);
-  int count = scan_white(view);
-  pony_assert(count >= 0);
+  size_t budget = SIZE_MAX;
+  detect(d, view, false);
+  scan_grey(d, &budget);
+  d->scan_stack = ponyint_viewrefstack_push(NULL, &d->scan_head);
+  scan_white(d, &budget);
+  d->scan_root = NULL;
+  pony_assert(d->scan_count >= 0);
 
-  printf("%p: %s\n", view->actor, count > 0 ? "COLLECTABLE" : "uncollectable");
+  printf("%p: %s\n", view->actor,
+    d->scan_count > 0 ? "COLLECTABLE" : "uncollectable");
 }
 
 static void check_views()
@@ -810,8 +1126,18 @@ static void cycle_dispatch(pony_ctx_t* ctx, pony_actor_t* self,
 {
   detector_t* d = (detector_t*)self;
 
+  if(((d->scan_root != NULL) || (d->pending != NULL)) &&
+    (msg->id != ACTORMSG_SCAN))
+  {
+    defer_msg(d, msg);
+    return;
+  }
+
   switch(msg->id)
   {
+    case ACTORMSG_SCAN:
+      break;
+
     case ACTORMSG_BLOCK:
     {
       block_msg_t* m = (block_msg_t*)msg;
@@ -842,6 +1168,8 @@ static void cycle_dispatch(pony_ctx_t* ctx, pony_actor_t* self,
     }
 #endif
   }
+
+  scan(ctx, d);
 }
 
 static pony_type_t cycle_type =
@@ -861,11 +1189,12 @@ static pony_type_t cycle_type =
   0,
   NULL,
   NULL,
-  NULL
+  NULL,
+  false
 };
 
 void ponyint_cycle_create(pony_ctx_t* ctx, uint32_t min_deferred,
-  uint32_t max_deferred, uint32_t conf_group)
+  uint32_t max_deferred, uint32_t conf_group, uint32_t budget)
 {
   if(min_deferred > 30)
     min_deferred = 30;
@@ -879,6 +1208,9 @@ void ponyint_cycle_create(pony_ctx_t* ctx, uint32_t min_deferred,
   if(conf_group > 30)
     conf_group = 30;
 
+  if(budget > 30)
+    budget = 30;
+
   cycle_detector = pony_create(ctx, &cycle_type);
   ponyint_actor_setsystem(cycle_detector);
 
@@ -886,6 +1218,7 @@ void ponyint_cycle_create(pony_ctx_t* ctx, uint32_t min_deferred,
   d->min_deferred = (size_t)1 << (size_t)min_deferred;
   d->max_deferred = (size_t)1 << (size_t)max_deferred;
   d->conf_group = (size_t)1 << (size_t)conf_group;
+  d->budget = (size_t)1 << (size_t)budget;
   d->next_deferred = min_deferred;
 }
 
@@ -10,7 +10,7 @@
 PONY_EXTERN_C_BEGIN
 
 void ponyint_cycle_create(pony_ctx_t* ctx, uint32_t min_deferred,
-  uint32_t max_deferred, uint32_t conf_group);
+  uint32_t max_deferred, uint32_t conf_group, uint32_t budget);
 
 void ponyint_cycle_block(pony_ctx_t* ctx, pony_actor_t* actor, gc_t* gc);
 
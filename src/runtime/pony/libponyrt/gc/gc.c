@@ -632,8 +632,13 @@ void encore_future_gc_acquireobject(pony_ctx_t* ctx, void* p, pony_type_t *t,
     if(mutability == PONY_TRACE_OPAQUE)
       return;
 
+    // The owner keeps the contents of an immutable object alive, so it
+    // must learn that the object is immutable.
     if(mutability == PONY_TRACE_IMMUTABLE)
+    {
       obj->immutable = true;
+      aquire_obj->immutable = true;
+    }
 
     if(!obj->immutable)
       recurse(ctx, p, t->trace);
@@ -112,6 +112,9 @@ typedef const struct _pony_type_t
   uint32_t** traits;
   void* fields;
   void* vtable;
+  /// Every object reachable from an instance is immutable, so instances
+  /// are traced with PONY_TRACE_IMMUTABLE.
+  bool immutable;
 } pony_type_t;
 
 /** Padding for actor types.
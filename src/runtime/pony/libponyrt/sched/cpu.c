@@ -368,3 +368,18 @@ uint64_t ponyint_cpu_tick()
 # endif
 #endif
 }
+
+uint64_t ponyint_cpu_nanos()
+{
+#if defined(PLATFORM_IS_WINDOWS)
+  LARGE_INTEGER count;
+  LARGE_INTEGER freq;
+  QueryPerformanceCounter(&count);
+  QueryPerformanceFrequency(&freq);
+  return (uint64_t)((double)count.QuadPart * 1e9 / (double)freq.QuadPart);
+#else
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return ((uint64_t)ts.tv_sec * 1000000000) + ts.tv_nsec;
+#endif
+}
@@ -23,6 +23,10 @@ void ponyint_cpu_relax();
 
 uint64_t ponyint_cpu_tick();
 
+/** Nanoseconds on a monotonic clock, for measuring elapsed time.
+ */
+uint64_t ponyint_cpu_nanos();
+
 PONY_EXTERN_C_END
 
 #endif
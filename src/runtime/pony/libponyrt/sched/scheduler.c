@@ -4,6 +4,7 @@
 
 #include "scheduler.h"
 #include "cpu.h"
+#include "timeline.h"
 #include "mpmcq.h"
 #include "../actor/actor.h"
 #include "../gc/cycle.h"
@@ -44,6 +45,9 @@ static bool use_yield;
 static mpmcq_t inject;
 static __pony_thread_local scheduler_t* this_scheduler;
 
+// The counters of threads that have stopped.
+static sched_stats_t retired_stats;
+
 /**
  * Gets the next actor from the scheduler queue.
  */
@@ -229,6 +233,7 @@ static pony_actor_t* steal(scheduler_t* sched, pony_actor_t* prev)
 {
   send_msg(0, SCHED_BLOCK, 0);
   uint64_t tsc = ponyint_cpu_tick();
+  uint64_t start = ponyint_timeline_enabled ? ponyint_cpu_nanos() : 0;
   pony_actor_t* actor;
 
   while(true)
@@ -240,8 +245,11 @@ static pony_actor_t* steal(scheduler_t* sched, pony_actor_t* prev)
     else
       actor = pop_global(victim);
 
+    STATS_ADD(&sched->ctx, steal_attempts, 1);
+
     if(actor != NULL)
     {
+      STATS_ADD(&sched->ctx, steals, 1);
       DTRACE3(WORK_STEAL_SUCCESSFUL, (uintptr_t)sched, (uintptr_t)victim, (uintptr_t)actor);
       break;
     }
@@ -251,6 +259,10 @@ static pony_actor_t* steal(scheduler_t* sched, pony_actor_t* prev)
     if(quiescent(sched, tsc, tsc2))
     {
       DTRACE2(WORK_STEAL_FAILURE, (uintptr_t)sched, (uintptr_t)victim);
+
+      if(ponyint_timeline_enabled)
+        ponyint_timeline_record(TIMELINE_STEAL, start, 0, 0);
+
       return NULL;
     }
 
@@ -265,6 +277,10 @@ static pony_actor_t* steal(scheduler_t* sched, pony_actor_t* prev)
   }
 
   send_msg(0, SCHED_UNBLOCK, 0);
+
+  if(ponyint_timeline_enabled)
+    ponyint_timeline_record(TIMELINE_STEAL, start, (uintptr_t)actor, 0);
+
   return actor;
 }
 
@@ -297,7 +313,22 @@ static void run(scheduler_t* sched)
 
     // Run the current actor and get the next actor.
     pony_ctx_t *ctx = &sched->ctx;
+    uint64_t start = 0;
+    uint32_t type_id = 0;
+
+    // The actor may be freed by the cycle detector as soon as it has run,
+    // so its type is read beforehand.
+    if(ponyint_timeline_enabled)
+    {
+      start = ponyint_cpu_nanos();
+      type_id = actor->type->id;
+    }
+
     bool reschedule = ponyint_actor_run(&ctx, actor, SCHED_BATCH);
+
+    if(ponyint_timeline_enabled)
+      ponyint_timeline_record(TIMELINE_ACTOR_RUN, start, (uintptr_t)actor,
+        type_id);
 #ifdef LAZY_IMPL
     sched = this_scheduler;
 #endif
@@ -397,6 +428,7 @@ static void *run_thread(void *arg)
   scheduler_t* sched = (scheduler_t*) arg;
   this_scheduler = sched;
   ponyint_cpu_affinity(sched->cpu);
+  ponyint_timeline_scheduler((uint32_t)(sched - scheduler), sched->cpu);
 
 #ifdef LAZY_IMPL
   context uctx;
@@ -425,6 +457,28 @@ static void *run_thread(void *arg)
   return NULL;
 }
 
+static void retire_stats(sched_stats_t* stats)
+{
+#define RETIRE(name, desc) \
+  __atomic_fetch_add(&retired_stats.name, \
+    __atomic_load_n(&stats->name, __ATOMIC_RELAXED), __ATOMIC_RELAXED);
+  SCHED_STATS_COUNTERS(RETIRE)
+#undef RETIRE
+}
+
+void ponyint_sched_stats(sched_stats_t* total)
+{
+#define SUM(name, desc) \
+  total->name = __atomic_load_n(&retired_stats.name, __ATOMIC_RELAXED); \
+  for(uint32_t i = 0; i < count; i++) \
+    total->name += __atomic_load_n(&sched[i].stats.name, __ATOMIC_RELAXED);
+
+  scheduler_t* sched = scheduler;
+  uint32_t count = sched != NULL ? scheduler_count : 0;
+  SCHED_STATS_COUNTERS(SUM)
+#undef SUM
+}
+
 static void ponyint_sched_shutdown()
 {
   uint32_t start;
@@ -439,20 +493,29 @@ static void ponyint_sched_shutdown()
 
   DTRACE0(RT_END);
 
+  // The main thread registered its own scheduler_t, which it now leaves.
+  if(this_scheduler != NULL && this_scheduler != &scheduler[0])
+    retire_stats(&this_scheduler->stats);
+
   // back to main thread, but uses ctx from schedule[0]
   this_scheduler = &scheduler[0];
   ponyint_cycle_terminate(&scheduler[0].ctx);
 
   for(uint32_t i = 0; i < scheduler_count; i++)
   {
+    retire_stats(&scheduler[i].stats);
     while(ponyint_messageq_pop(&scheduler[i].mq) != NULL);
     ponyint_messageq_destroy(&scheduler[i].mq);
     ponyint_mpmcq_destroy(&scheduler[i].q);
   }
 
-  ponyint_pool_free_size(scheduler_count * sizeof(scheduler_t), scheduler);
+  // Clear the array before freeing it, so that summing the counters from a
+  // signal handler no longer looks at it.
+  scheduler_t* old = scheduler;
+  uint32_t old_count = scheduler_count;
   scheduler = NULL;
   scheduler_count = 0;
+  ponyint_pool_free_size(old_count * sizeof(scheduler_t), old);
 
   ponyint_mpmcq_destroy(&inject);
 }
@@ -556,6 +619,7 @@ PONY_API void pony_unregister_thread()
   if(this_scheduler == NULL)
     return;
 
+  retire_stats(&this_scheduler->stats);
   POOL_FREE(scheduler_t, this_scheduler);
   this_scheduler = NULL;
 
@@ -10,6 +10,7 @@
 #include "gc/gc.h"
 #include "gc/serialise.h"
 #include "mpmcq.h"
+#include "stats.h"
 
 PONY_EXTERN_C_BEGIN
 
@@ -54,8 +55,31 @@ struct scheduler_t
   // These are accessed by other scheduler threads. The mpmcq_t is aligned.
   mpmcq_t q;
   messageq_t mq;
+
+  // Written only by the owning thread, read when the counters are summed.
+  alignas(64) sched_stats_t stats;
 };
 
+/** The counters of the thread whose context is ctx.
+ *
+ * Every context, including those of threads registered with
+ * pony_register_thread, lives inside a scheduler_t.
+ */
+static inline sched_stats_t* ponyint_sched_stats_of(pony_ctx_t* ctx)
+{
+  return &((scheduler_t*)((char*)ctx - offsetof(scheduler_t, ctx)))->stats;
+}
+
+/** Add n to a counter of the thread whose context is ctx. Only that thread
+ * writes the counter, so a relaxed load and store are enough.
+ */
+#define STATS_ADD(ctx, counter, n) \
+  do { \
+    uint64_t* _c = &ponyint_sched_stats_of(ctx)->counter; \
+    __atomic_store_n(_c, __atomic_load_n(_c, __ATOMIC_RELAXED) + (n), \
+      __ATOMIC_RELAXED); \
+  } while(0)
+
 pony_ctx_t* ponyint_sched_init(uint32_t threads, bool noyield, bool nopin,
   bool pinasio);
 
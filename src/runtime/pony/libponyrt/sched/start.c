@@ -19,6 +19,7 @@ typedef struct options_t
   uint32_t cd_min_deferred;
   uint32_t cd_max_deferred;
   uint32_t cd_conf_group;
+  uint32_t cd_budget;
   size_t gc_initial;
   double gc_factor;
   bool noyield;
@@ -37,6 +38,7 @@ enum
   OPT_CDMIN,
   OPT_CDMAX,
   OPT_CDCONF,
+  OPT_CDBUDGET,
   OPT_GCINITIAL,
   OPT_GCFACTOR,
   OPT_NOYIELD,
@@ -51,6 +53,7 @@ static opt_arg_t args[] =
   {"ponycdmin", 0, OPT_ARG_REQUIRED, OPT_CDMIN},
   {"ponycdmax", 0, OPT_ARG_REQUIRED, OPT_CDMAX},
   {"ponycdconf", 0, OPT_ARG_REQUIRED, OPT_CDCONF},
+  {"ponycdbudget", 0, OPT_ARG_REQUIRED, OPT_CDBUDGET},
   {"ponygcinitial", 0, OPT_ARG_REQUIRED, OPT_GCINITIAL},
   {"ponygcfactor", 0, OPT_ARG_REQUIRED, OPT_GCFACTOR},
   {"ponynoyield", 0, OPT_ARG_NONE, OPT_NOYIELD},
@@ -75,6 +78,7 @@ static int parse_opts(int argc, char** argv, options_t* opt)
       case OPT_CDMIN: opt->cd_min_deferred = atoi(s.arg_val); break;
       case OPT_CDMAX: opt->cd_max_deferred = atoi(s.arg_val); break;
       case OPT_CDCONF: opt->cd_conf_group = atoi(s.arg_val); break;
+      case OPT_CDBUDGET: opt->cd_budget = atoi(s.arg_val); break;
       case OPT_GCINITIAL: opt->gc_initial = atoi(s.arg_val); break;
       case OPT_GCFACTOR: opt->gc_factor = atof(s.arg_val); break;
       case OPT_NOYIELD: opt->noyield = true; break;
@@ -100,6 +104,7 @@ PONY_API int pony_init(int argc, char** argv)
   opt.cd_min_deferred = 4;
   opt.cd_max_deferred = 8;
   opt.cd_conf_group = 6;
+  opt.cd_budget = 12;
   opt.gc_initial = 14;
   opt.gc_factor = 2.0f;
 
@@ -117,7 +122,8 @@ PONY_API int pony_init(int argc, char** argv)
     opt.pinasio);
 
   ponyint_cycle_create(ctx,
-    opt.cd_min_deferred, opt.cd_max_deferred, opt.cd_conf_group);
+    opt.cd_min_deferred, opt.cd_max_deferred, opt.cd_conf_group,
+    opt.cd_budget);
 
   return argc;
 }
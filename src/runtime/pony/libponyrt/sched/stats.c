@@ -0,0 +1,97 @@
+#include "stats.h"
+#include <string.h>
+
+#ifndef PLATFORM_IS_WINDOWS
+#include <signal.h>
+#include <unistd.h>
+#endif
+
+// Appends s to buf at *pos, truncating at size.
+static void append(char* buf, size_t size, size_t* pos, const char* s)
+{
+  size_t len = strlen(s);
+
+  if(len > size - *pos)
+    len = size - *pos;
+
+  memcpy(buf + *pos, s, len);
+  *pos += len;
+}
+
+// Appends n in decimal; snprintf is not async-signal-safe.
+static void append_u64(char* buf, size_t size, size_t* pos, uint64_t n)
+{
+  char digits[21];
+  char* p = digits + sizeof(digits);
+  *--p = '\0';
+
+  do
+  {
+    *--p = (char)('0' + n % 10);
+    n /= 10;
+  } while(n != 0);
+
+  append(buf, size, pos, p);
+}
+
+void ponyint_stats_dump(int fd)
+{
+  sched_stats_t total;
+  ponyint_sched_stats(&total);
+
+  char buf[2048];
+  size_t pos = 0;
+  append(buf, sizeof(buf), &pos, "encore runtime stats\n");
+
+#define LINE(name, desc) \
+  append(buf, sizeof(buf), &pos, "  " #name " "); \
+  append_u64(buf, sizeof(buf), &pos, total.name); \
+  append(buf, sizeof(buf), &pos, " (" desc ")\n");
+
+  SCHED_STATS_COUNTERS(LINE)
+#undef LINE
+
+  append(buf, sizeof(buf), &pos, "  stacks_in_use ");
+  append_u64(buf, sizeof(buf), &pos,
+    total.stacks_acquired - total.stacks_released);
+  append(buf, sizeof(buf), &pos, "\n");
+
+#ifndef PLATFORM_IS_WINDOWS
+  const char* p = buf;
+
+  while(pos > 0)
+  {
+    ssize_t n = write(fd, p, pos);
+
+    if(n <= 0)
+      break;
+
+    p += n;
+    pos -= (size_t)n;
+  }
+#else
+  (void)fd;
+#endif
+}
+
+#ifndef PLATFORM_IS_WINDOWS
+static void dump_handler(int sig)
+{
+  (void)sig;
+  ponyint_stats_dump(STDERR_FILENO);
+}
+#endif
+
+void ponyint_stats_signal(int sig)
+{
+#ifndef PLATFORM_IS_WINDOWS
+  struct sigaction sa;
+  memset(&sa, 0, sizeof(sa));
+  sa.sa_handler = dump_handler;
+  sa.sa_flags = SA_RESTART;
+  sigemptyset(&sa.sa_mask);
+  sigaction(sig, &sa, NULL);
+#else
+  (void)sig;
+#endif
+}
@@ -0,0 +1,57 @@
+#ifndef sched_stats_h
+#define sched_stats_h
+
+#include <stdint.h>
+#include <stddef.h>
+#include <platform.h>
+
+PONY_EXTERN_C_BEGIN
+
+/** The runtime counters, as X(name, description).
+ *
+ * Every thread running actors keeps its own copy of these in its
+ * scheduler_t, on cache lines of its own, and only that thread writes to
+ * it. Updating a counter is therefore a plain add, with no atomic
+ * read-modify-write and no sharing between cores. Reading them sums the
+ * copies of all threads, which may be a few events behind.
+ */
+#define SCHED_STATS_COUNTERS(X) \
+  X(messages, "application messages processed") \
+  X(steal_attempts, "attempts to steal an actor") \
+  X(steals, "actors stolen") \
+  X(gc_count, "actor heap collections") \
+  X(gc_pause_ns, "nanoseconds spent collecting actor heaps") \
+  X(bytes_allocated, "bytes allocated on actor heaps") \
+  X(futures_created, "futures created") \
+  X(futures_blocked, "gets and awaits that had to wait for a future") \
+  X(stacks_acquired, "actor stacks taken from the pool") \
+  X(stacks_released, "actor stacks returned to the pool") \
+  X(cd_collected, "actors collected by the cycle detector") \
+  X(cd_yields, "cycle detections that ran out of budget and carried on later")
+
+#define SCHED_STATS_FIELD(name, desc) uint64_t name;
+
+typedef struct sched_stats_t
+{
+  SCHED_STATS_COUNTERS(SCHED_STATS_FIELD)
+} sched_stats_t;
+
+#undef SCHED_STATS_FIELD
+
+/** Sum the counters of all threads into \p total.
+ */
+void ponyint_sched_stats(sched_stats_t* total);
+
+/** Write the counters of all threads, one per line, to \p fd.
+ *
+ * This only uses write(2), so it may be called from a signal handler.
+ */
+void ponyint_stats_dump(int fd);
+
+/** Dump the counters to stderr whenever the process gets signal \p sig.
+ */
+void ponyint_stats_signal(int sig);
+
+PONY_EXTERN_C_END
+
+#endif
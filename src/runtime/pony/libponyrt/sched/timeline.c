@@ -0,0 +1,275 @@
+#define PONY_WANT_ATOMIC_DEFS
+
+#include "timeline.h"
+#include "cpu.h"
+#include "../mem/pool.h"
+#include <stdio.h>
+#include <string.h>
+
+#ifdef PLATFORM_IS_WINDOWS
+#  include <windows.h>
+#else
+#  include <time.h>
+#endif
+
+// Events per thread. At a few million events a second, this holds more
+// than a flush interval's worth.
+#define RING_SIZE 65536
+#define FLUSH_NS 1000000
+#define OUT_BUFFER (1 << 20)
+
+typedef struct timeline_event_t
+{
+  uint64_t ts;
+  uint64_t dur;
+  uintptr_t a;
+  uintptr_t b;
+  uint32_t kind;
+} timeline_event_t;
+
+// A single producer, single consumer ring. Only the owning thread moves
+// head, and only the flush thread moves tail.
+typedef struct timeline_ring_t
+{
+  alignas(64) PONY_ATOMIC(uint64_t) head;
+  alignas(64) PONY_ATOMIC(uint64_t) tail;
+  uint64_t dropped;
+  uint32_t tid;
+  int32_t scheduler;
+  uint32_t cpu;
+  bool named;
+  struct timeline_ring_t* next;
+  timeline_event_t events[RING_SIZE];
+} timeline_ring_t;
+
+bool ponyint_timeline_enabled;
+
+static __pony_thread_local timeline_ring_t* this_ring;
+static PONY_ATOMIC(timeline_ring_t*) rings;
+static PONY_ATOMIC(uint32_t) ring_count;
+static PONY_ATOMIC(bool) stopping;
+static pony_thread_id_t flush_tid;
+static FILE* out;
+static uint64_t epoch;
+static bool first_event;
+
+static timeline_ring_t* get_ring()
+{
+  timeline_ring_t* r = this_ring;
+
+  if(r != NULL)
+    return r;
+
+  r = (timeline_ring_t*)ponyint_pool_alloc_size(sizeof(timeline_ring_t));
+  memset(r, 0, sizeof(timeline_ring_t));
+  r->tid = atomic_fetch_add_explicit(&ring_count, 1, memory_order_relaxed);
+  r->scheduler = -1;
+  r->next = atomic_load_explicit(&rings, memory_order_relaxed);
+
+  while(!atomic_compare_exchange_weak_explicit(&rings, &r->next, r,
+    memory_order_release, memory_order_relaxed))
+    ;
+
+  this_ring = r;
+  return r;
+}
+
+void ponyint_timeline_scheduler(uint32_t index, uint32_t cpu)
+{
+  if(!ponyint_timeline_enabled)
+    return;
+
+  timeline_ring_t* r = get_ring();
+  r->cpu = cpu;
+  r->scheduler = (int32_t)index;
+}
+
+void ponyint_timeline_record(timeline_kind_t kind, uint64_t start,
+  uintptr_t a, uintptr_t b)
+{
+  timeline_ring_t* r = get_ring();
+  uint64_t now = ponyint_cpu_nanos();
+  uint64_t head = atomic_load_explicit(&r->head, memory_order_relaxed);
+  uint64_t tail = atomic_load_explicit(&r->tail, memory_order_acquire);
+
+  if(head - tail == RING_SIZE)
+  {
+    r->dropped++;
+    return;
+  }
+
+  timeline_event_t* e = &r->events[head & (RING_SIZE - 1)];
+
+  if((kind == TIMELINE_FUTURE_BLOCK) || (kind == TIMELINE_FUTURE_UNBLOCK))
+  {
+    e->ts = now;
+    e->dur = 0;
+  } else {
+    e->ts = start;
+    e->dur = now - start;
+  }
+
+  e->a = a;
+  e->b = b;
+  e->kind = kind;
+  atomic_store_explicit(&r->head, head + 1, memory_order_release);
+}
+
+// Chrome wants microseconds; keep the nanoseconds as decimals.
+static void write_us(uint64_t ns)
+{
+  fprintf(out, "%llu.%03llu", (unsigned long long)(ns / 1000),
+    (unsigned long long)(ns % 1000));
+}
+
+static void write_event(timeline_ring_t* r, timeline_event_t* e)
+{
+  fputs(first_event ? "\n" : ",\n", out);
+  first_event = false;
+
+  const char* name;
+  const char* ph = "X";
+
+  switch(e->kind)
+  {
+    case TIMELINE_ACTOR_RUN: name = "actor"; break;
+    case TIMELINE_GC: name = "gc"; break;
+    case TIMELINE_STEAL: name = e->a != 0 ? "steal" : "steal (none)"; break;
+    case TIMELINE_FUTURE_BLOCK: name = "blocked on future"; ph = "b"; break;
+    default: name = "blocked on future"; ph = "e"; break;
+  }
+
+  fprintf(out, "{\"name\":\"%s\",\"cat\":\"encore\",\"ph\":\"%s\","
+    "\"pid\":1,\"tid\":%u,\"ts\":", name, ph, r->tid);
+  write_us(e->ts > epoch ? e->ts - epoch : 0);
+
+  switch(e->kind)
+  {
+    case TIMELINE_ACTOR_RUN:
+    case TIMELINE_GC:
+      fputs(",\"dur\":", out);
+      write_us(e->dur);
+      fprintf(out, ",\"args\":{\"actor\":\"0x%llx\",\"type\":%llu}}",
+        (unsigned long long)e->a, (unsigned long long)e->b);
+      break;
+
+    case TIMELINE_STEAL:
+      fputs(",\"dur\":", out);
+      write_us(e->dur);
+      fprintf(out, ",\"args\":{\"actor\":\"0x%llx\"}}",
+        (unsigned long long)e->a);
+      break;
+
+    default:
+      // Async events are matched by id, as an actor may be unblocked on
+      // another thread than it blocked on.
+      fprintf(out, ",\"id\":\"0x%llx\",\"args\":{\"future\":\"0x%llx\"}}",
+        (unsigned long long)e->a, (unsigned long long)e->b);
+      break;
+  }
+}
+
+static void write_name(timeline_ring_t* r)
+{
+  fputs(first_event ? "\n" : ",\n", out);
+  first_event = false;
+  fprintf(out, "{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,"
+    "\"tid\":%u,\"args\":{\"name\":\"", r->tid);
+
+  if(r->scheduler >= 0)
+    fprintf(out, "scheduler %d (cpu %u)", r->scheduler, r->cpu);
+  else
+    fprintf(out, "thread %u", r->tid);
+
+  fputs("\"}}", out);
+  r->named = true;
+}
+
+static void flush()
+{
+  timeline_ring_t* r = atomic_load_explicit(&rings, memory_order_acquire);
+
+  for(; r != NULL; r = r->next)
+  {
+    uint64_t tail = atomic_load_explicit(&r->tail, memory_order_relaxed);
+    uint64_t head = atomic_load_explicit(&r->head, memory_order_acquire);
+
+    if(!r->named && (r->scheduler >= 0 || head != tail))
+      write_name(r);
+
+    for(; tail != head; tail++)
+      write_event(r, &r->events[tail & (RING_SIZE - 1)]);
+
+    atomic_store_explicit(&r->tail, tail, memory_order_release);
+  }
+}
+
+static void nap()
+{
+#ifdef PLATFORM_IS_WINDOWS
+  Sleep(FLUSH_NS / 1000000);
+#else
+  struct timespec ts = {0, FLUSH_NS};
+  nanosleep(&ts, NULL);
+#endif
+}
+
+static DECLARE_THREAD_FN(flush_thread)
+{
+  (void)arg;
+
+  while(!atomic_load_explicit(&stopping, memory_order_acquire))
+  {
+    nap();
+    flush();
+  }
+
+  return 0;
+}
+
+bool ponyint_timeline_start(const char* path)
+{
+  out = fopen(path, "w");
+
+  if(out == NULL)
+    return false;
+
+  setvbuf(out, NULL, _IOFBF, OUT_BUFFER);
+  epoch = ponyint_cpu_nanos();
+  first_event = true;
+  fputs("{\"displayTimeUnit\":\"ns\",\"traceEvents\":[", out);
+
+  if(!ponyint_thread_create(&flush_tid, flush_thread, (uint32_t)-1, NULL))
+  {
+    fclose(out);
+    out = NULL;
+    return false;
+  }
+
+  ponyint_timeline_enabled = true;
+  return true;
+}
+
+void ponyint_timeline_stop()
+{
+  if(out == NULL)
+    return;
+
+  atomic_store_explicit(&stopping, true, memory_order_release);
+  ponyint_thread_join(flush_tid);
+  flush();
+  fputs("\n]}\n", out);
+  fclose(out);
+  out = NULL;
+  ponyint_timeline_enabled = false;
+
+  uint64_t dropped = 0;
+  timeline_ring_t* r = atomic_load_explicit(&rings, memory_order_acquire);
+
+  for(; r != NULL; r = r->next)
+    dropped += r->dropped;
+
+  if(dropped > 0)
+    fprintf(stderr, "encore timeline: dropped %llu events\n",
+      (unsigned long long)dropped);
+}
@@ -0,0 +1,59 @@
+#ifndef sched_timeline_h
+#define sched_timeline_h
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <platform.h>
+
+PONY_EXTERN_C_BEGIN
+
+/** A timeline of what every thread of the runtime did, for viewing in
+ * chrome://tracing or Perfetto.
+ *
+ * The runtime records events at the same places as the DTrace probes:
+ * actors running on a scheduler thread, garbage collections, steals and
+ * actors blocking on futures. Each thread appends its events to a ring of
+ * its own, which is lock-free and never blocks the thread: when a ring is
+ * full, events are dropped and counted. A background thread drains the
+ * rings into a file in the Chrome Trace Event JSON format.
+ */
+typedef enum
+{
+  TIMELINE_ACTOR_RUN,
+  TIMELINE_GC,
+  TIMELINE_STEAL,
+  TIMELINE_FUTURE_BLOCK,
+  TIMELINE_FUTURE_UNBLOCK
+} timeline_kind_t;
+
+extern bool ponyint_timeline_enabled;
+
+/** Start recording to the file at \p path. Returns false if the file
+ * could not be opened.
+ */
+bool ponyint_timeline_start(const char* path);
+
+/** Write all remaining events and close the file. This must only be
+ * called once all scheduler threads have stopped.
+ */
+void ponyint_timeline_stop();
+
+/** Name the track of the calling thread after scheduler \p index, which
+ * runs on \p cpu.
+ */
+void ponyint_timeline_scheduler(uint32_t index, uint32_t cpu);
+
+/** Record an event of kind \p kind that started at \p start (from
+ * ponyint_cpu_nanos) and ends now.
+ *
+ * For an actor run and a GC, \p a is the actor and \p b its type id. For
+ * a steal, \p a is the actor stolen, or 0 if none was. For a future block
+ * or unblock, \p a is the actor and \p b the future, and \p start is
+ * ignored.
+ */
+void ponyint_timeline_record(timeline_kind_t kind, uint64_t start,
+  uintptr_t a, uintptr_t b);
+
+PONY_EXTERN_C_END
+
+#endif
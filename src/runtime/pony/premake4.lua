@@ -193,6 +193,13 @@ project "tuple"
     "../tuple/tuple.c"
   }
 
+project "json"
+  c_lib()
+  files {
+    "../json/jsontape.h",
+    "../json/jsontape.c"
+  }
+
 project "range"
   c_lib()
   files {
@@ -200,6 +207,13 @@ project "range"
     "../range/range.c"
   }
 
+project "string"
+  c_lib()
+  files {
+    "../string/stringops.h",
+    "../string/stringops.c"
+  }
+
 project "task"
   c_lib()
   files {
@@ -247,11 +261,10 @@ project "stream"
     "../stream/stream.c"
   }
 
--- -- project "set"
--- --   kind "StaticLib"
--- --   language "C"
--- --   links { "closure" }
--- --   includedirs { "../closure" }
--- --   files {
--- --     "../set/set.c"
--- --   }
+project "set"
+  c_lib()
+  links { "closure" }
+  files {
+    "../set/set.h",
+    "../set/set.c"
+  }
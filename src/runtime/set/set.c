@@ -2,251 +2,531 @@
    @file set.c
 */
 #include "set.h"
+#include <stdio.h>
+#include <stdint.h>
+#include <string.h>
 #include <assert.h>
 
-// Controls whether malloc of pony_alloc is to be used
-#define USE_PONY_ALLOC 1
-
-#ifdef USE_PONY_ALLOC
-  #include <pony.h>
-  #include "../libponyrt/actor/actor.h"
-  // Tobias: this is a hack to make top-level functions work as they are implemented as closures right now
-  // This hack creates a small memory leak which we can safely ignore until top-level functions change.
-  #define ALLOC(size) (actor_current() ? pony_alloc(size) : malloc(size))
-  #define FREE(ptr)
-#else
-  #include <stdlib.h> 
-  #define ALLOC(size) malloc(size)
-  #define FREE(ptr) free(ptr)
-#endif
-
-#define NOP 0
-#define TRUE 1
-#define FALSE 0
+// The minimum degree of the B-tree. Every node except the root holds
+// between SET_DEGREE - 1 and SET_MAX_KEYS elements, and internal nodes
+// have one more child than they have elements. With a degree of 8 the
+// keys of a node fill two cache lines, and a set of a million
+// elements is at most seven nodes deep.
+#define SET_DEGREE 8
+#define SET_MAX_KEYS (2 * SET_DEGREE - 1)
+
+typedef struct node node_t;
 
 struct node{
-  void *elem;
-  struct node* left;
-  struct node* right;
+  size_t n;
+  bool leaf;
+  void *keys[SET_MAX_KEYS];
+  // Only used by internal nodes
+  node_t *children[SET_MAX_KEYS + 1];
 };
 
 struct set{
-  struct node *root;
+  node_t *root;
+  size_t size;
 };
 
-set_t *set_mk(void){
-  set_t *set = ALLOC(sizeof(set_t));
-  if(set)
-    set->root = NULL;
-  return set;
-}
+pony_type_t set_type =
+  {
+    .id = ID_SET,
+    .size = sizeof(struct set),
+    .trace = set_trace,
+  };
 
-static struct node *node_mk(void *elem){
-  struct node *node = ALLOC(sizeof(struct node));
-  if(node){
-    node->elem = elem;
-    node->left = NULL;
-    node->right = NULL;
+static void node_trace(pony_ctx_t *ctx, void *p)
+{
+  node_t *node = p;
+  if (!node->leaf) {
+    for (size_t i = 0; i <= node->n; i++) {
+      encore_trace_object(ctx, node->children[i], node_trace);
+    }
   }
+}
+
+void set_trace(pony_ctx_t *ctx, void *p)
+{
+  assert(p);
+  set_t *set = p;
+  encore_trace_object(ctx, set->root, node_trace);
+}
+
+static node_t *node_mk(pony_ctx_t **ctx, bool leaf)
+{
+  node_t *node = encore_alloc(*ctx, sizeof(node_t));
+  node->leaf = leaf;
   return node;
 }
 
-bool set_add(set_t *set, void *elem){
-  if(set){
-    if(!set->root){
-      set->root = node_mk(elem);
-      return TRUE;
+set_t *set_mk(pony_ctx_t **ctx)
+{
+  return encore_alloc(*ctx, sizeof(set_t));
+}
+
+// The index of the first key of node that is not less than elem, or n
+static inline size_t node_find(node_t *node, void *elem)
+{
+  size_t lo = 0;
+  size_t hi = node->n;
+  while (lo < hi) {
+    size_t mid = (lo + hi) / 2;
+    if ((uintptr_t)node->keys[mid] < (uintptr_t)elem) {
+      lo = mid + 1;
+    } else {
+      hi = mid;
+    }
+  }
+  return lo;
+}
+
+static inline bool node_has(node_t *node, size_t i, void *elem)
+{
+  return i < node->n && node->keys[i] == elem;
+}
+
+// Open a gap at key i and at the child after it
+static void node_shift_right(node_t *node, size_t i)
+{
+  memmove(&node->keys[i + 1], &node->keys[i],
+          (node->n - i) * sizeof(void*));
+  if (!node->leaf) {
+    memmove(&node->children[i + 2], &node->children[i + 1],
+            (node->n - i) * sizeof(node_t*));
+  }
+}
+
+// Close the gap left by removing key i and the child after it
+static void node_shift_left(node_t *node, size_t i)
+{
+  memmove(&node->keys[i], &node->keys[i + 1],
+          (node->n - i - 1) * sizeof(void*));
+  if (!node->leaf) {
+    memmove(&node->children[i + 1], &node->children[i + 2],
+            (node->n - i - 1) * sizeof(node_t*));
+    node->children[node->n] = NULL;
+  }
+  node->n--;
+}
+
+// Split the full child i of node around its median, which moves up
+static void node_split_child(pony_ctx_t **ctx, node_t *node, size_t i)
+{
+  node_t *child = node->children[i];
+  node_t *sibling = node_mk(ctx, child->leaf);
+
+  memcpy(sibling->keys, &child->keys[SET_DEGREE],
+         (SET_DEGREE - 1) * sizeof(void*));
+  if (!child->leaf) {
+    memcpy(sibling->children, &child->children[SET_DEGREE],
+           SET_DEGREE * sizeof(node_t*));
+    memset(&child->children[SET_DEGREE], 0, SET_DEGREE * sizeof(node_t*));
+  }
+  sibling->n = SET_DEGREE - 1;
+  child->n = SET_DEGREE - 1;
+
+  node_shift_right(node, i);
+  node->keys[i] = child->keys[SET_DEGREE - 1];
+  node->children[i + 1] = sibling;
+  node->n++;
+}
+
+bool set_add(pony_ctx_t **ctx, set_t *set, void *elem)
+{
+  if (!set->root) {
+    set->root = node_mk(ctx, true);
+  }
+
+  // Split full nodes on the way down, so that there is always room
+  // for the median of a split child
+  if (set->root->n == SET_MAX_KEYS) {
+    node_t *root = node_mk(ctx, false);
+    root->children[0] = set->root;
+    node_split_child(ctx, root, 0);
+    set->root = root;
+  }
+
+  node_t *node = set->root;
+  while (true) {
+    size_t i = node_find(node, elem);
+    if (node_has(node, i, elem)) {
+      return false;
+    }
+
+    if (node->leaf) {
+      node_shift_right(node, i);
+      node->keys[i] = elem;
+      node->n++;
+      set->size++;
+      return true;
     }
-    struct node **cursor = &(set->root);
-    while(*cursor != NULL && (*cursor)->elem != elem){
-      cursor = (*cursor)->elem > elem? &((*cursor)->left): &((*cursor)->right);
+
+    if (node->children[i]->n == SET_MAX_KEYS) {
+      node_split_child(ctx, node, i);
+      if (node->keys[i] == elem) {
+        return false;
+      } else if ((uintptr_t)node->keys[i] < (uintptr_t)elem) {
+        i++;
+      }
     }
-    if(*cursor == NULL){
-      *cursor = node_mk(elem);
-      return TRUE;
-    }else // (*cursor)->elem == elem  -- the element was already in the list
-      return FALSE;
-  }
-  return FALSE;
-}
-
-bool set_elem(set_t *set, void *elem){
-  if(set){
-    struct node *cursor = set->root;
-    while(cursor != NULL){
-      if(cursor->elem > elem)
-        cursor = cursor->left;
-      else if(cursor->elem < elem)
-        cursor = cursor->right;
-      else // cursor->elem == elem
-        return TRUE;
+    node = node->children[i];
+  }
+}
+
+bool set_elem(set_t *set, void *elem)
+{
+  node_t *node = set ? set->root : NULL;
+  while (node) {
+    size_t i = node_find(node, elem);
+    if (node_has(node, i, elem)) {
+      return true;
     }
+    node = node->leaf ? NULL : node->children[i];
   }
-  return FALSE;
+  return false;
 }
 
-static struct node *extractMin(struct node** root){
-  struct node **cursor = root;
-  while((*cursor)->left)
-    cursor = &((*cursor)->left);
-  struct node *tmp = *cursor;
-  *cursor = (*cursor)->right;
-  return tmp;
+static void *node_min(node_t *node)
+{
+  while (!node->leaf) {
+    node = node->children[0];
+  }
+  return node->keys[0];
 }
 
-static void removeNode(struct node **nodePtr){
-  assert(*nodePtr);
-  struct node *tmp = *nodePtr;
-  if(!tmp->right)
-    *nodePtr = (*nodePtr)->left;
-  else{
-    struct node *newRoot = extractMin(&(tmp->right));
-    newRoot->left = (*nodePtr)->left;
-    newRoot->right = (*nodePtr)->right;
-    *nodePtr = newRoot;
+static void *node_max(node_t *node)
+{
+  while (!node->leaf) {
+    node = node->children[node->n];
   }
-  FREE(tmp);
+  return node->keys[node->n - 1];
 }
 
-bool set_remove(set_t *set, void *elem){
-  if(!set || !(set->root))
-    return FALSE;
-  struct node **cursor = &(set->root);
-  while(*cursor != NULL && (*cursor)->elem != elem){
-    cursor = (*cursor)->elem > elem? &((*cursor)->left): &((*cursor)->right);
+// Merge child i + 1 and key i into child i
+static void node_merge(node_t *node, size_t i)
+{
+  node_t *left = node->children[i];
+  node_t *right = node->children[i + 1];
+
+  left->keys[left->n] = node->keys[i];
+  memcpy(&left->keys[left->n + 1], right->keys, right->n * sizeof(void*));
+  if (!left->leaf) {
+    memcpy(&left->children[left->n + 1], right->children,
+           (right->n + 1) * sizeof(node_t*));
+  }
+  left->n += right->n + 1;
+
+  node_shift_left(node, i);
+}
+
+// Make sure child c has at least SET_DEGREE keys before descending into
+// it, by rotating a key from a sibling or merging with one. Returns the
+// new index of the child.
+static size_t node_fill(node_t *node, size_t c)
+{
+  node_t *child = node->children[c];
+  if (child->n >= SET_DEGREE) {
+    return c;
+  }
+
+  if (c > 0 && node->children[c - 1]->n >= SET_DEGREE) {
+    node_t *sibling = node->children[c - 1];
+    node_shift_right(child, 0);
+    if (!child->leaf) {
+      child->children[1] = child->children[0];
+      child->children[0] = sibling->children[sibling->n];
+      sibling->children[sibling->n] = NULL;
+    }
+    child->keys[0] = node->keys[c - 1];
+    child->n++;
+    node->keys[c - 1] = sibling->keys[--sibling->n];
+    return c;
+  }
+
+  if (c < node->n && node->children[c + 1]->n >= SET_DEGREE) {
+    node_t *sibling = node->children[c + 1];
+    child->keys[child->n] = node->keys[c];
+    if (!child->leaf) {
+      child->children[child->n + 1] = sibling->children[0];
+      sibling->children[0] = sibling->children[1];
+    }
+    child->n++;
+    node->keys[c] = sibling->keys[0];
+    node_shift_left(sibling, 0);
+    return c;
   }
-  if(*cursor == NULL)
-    return FALSE;
-  else{ // the element was found and should be removed
-    removeNode(cursor);
-    return TRUE;
+
+  if (c < node->n) {
+    node_merge(node, c);
+    return c;
   }
+
+  node_merge(node, c - 1);
+  return c - 1;
 }
 
-static bool node_subset(struct node *node, set_t *set){
-  if(!node)
-    return TRUE;
-  return set_elem(set, node->elem) && 
-    node_subset(node->left, set) && 
-    node_subset(node->right, set);
+// Remove elem from below node, which has at least SET_DEGREE keys
+// unless it is the root
+static bool node_remove(node_t *node, void *elem)
+{
+  while (true) {
+    size_t i = node_find(node, elem);
+    if (node_has(node, i, elem)) {
+      if (node->leaf) {
+        node_shift_left(node, i);
+        return true;
+      }
 
+      node_t *left = node->children[i];
+      node_t *right = node->children[i + 1];
+      if (left->n >= SET_DEGREE) {
+        elem = node_max(left);
+        node->keys[i] = elem;
+        node = left;
+      } else if (right->n >= SET_DEGREE) {
+        elem = node_min(right);
+        node->keys[i] = elem;
+        node = right;
+      } else {
+        node_merge(node, i);
+        node = left;
+      }
+    } else if (node->leaf) {
+      return false;
+    } else {
+      node = node->children[node_fill(node, i)];
+    }
+  }
 }
 
-bool set_subset(set_t *sub, set_t *super){
-  if(sub)
-    return node_subset(sub->root, super);
-  else
-    return FALSE;
+bool set_remove(set_t *set, void *elem)
+{
+  if (!set || !set->root) {
+    return false;
+  }
+
+  bool removed = node_remove(set->root, elem);
+  if (removed) {
+    set->size--;
+  }
+
+  node_t *root = set->root;
+  if (root->n == 0) {
+    set->root = root->leaf ? NULL : root->children[0];
+  }
+  return removed;
 }
 
-bool set_eq(set_t *set, set_t *other){
-  return set_subset(set, other) && set_subset(other, set);
+size_t set_size(set_t *set)
+{
+  return set ? set->size : 0;
 }
 
-static void cloneNode(struct node *from, struct node **to){
-  if(from){
-    *to = node_mk(from->elem);
-    cloneNode(from->left, &((*to)->left));
-    cloneNode(from->right, &((*to)->right));
+// Build a tree of the n elements at elems, all of whose leaves are at
+// the depth at which a tree can hold at most capacity elements
+static node_t *node_build(pony_ctx_t **ctx, void *elems[], size_t n,
+                          size_t capacity)
+{
+  if (capacity == SET_MAX_KEYS) {
+    node_t *leaf = node_mk(ctx, true);
+    memcpy(leaf->keys, elems, n * sizeof(void*));
+    leaf->n = n;
+    return leaf;
   }
+
+  size_t child_capacity = (capacity + 1) / (SET_MAX_KEYS + 1) - 1;
+  size_t children = (n + child_capacity + 1) / (child_capacity + 1);
+  size_t per_child = (n - children + 1) / children;
+  size_t extra = (n - children + 1) % children;
+
+  node_t *node = node_mk(ctx, false);
+  for (size_t c = 0; c < children; c++) {
+    size_t count = per_child + (c < extra);
+    node->children[c] = node_build(ctx, elems, count, child_capacity);
+    elems += count;
+    if (c < children - 1) {
+      node->keys[c] = *elems++;
+    }
+  }
+  node->n = children - 1;
+  return node;
 }
 
-set_t *set_clone(set_t *set){
-  set_t *newSet = NULL;
-  if(set)
+set_t *set_from_sorted(pony_ctx_t **ctx, void *elems[], size_t n)
+{
+  set_t *set = set_mk(ctx);
+  if (n > 0) {
+    size_t capacity = SET_MAX_KEYS;
+    while (capacity < n) {
+      capacity = (capacity + 1) * (SET_MAX_KEYS + 1) - 1;
+    }
+    set->root = node_build(ctx, elems, n, capacity);
+    set->size = n;
+  }
+  return set;
+}
 
-    newSet = set_mk();
-  if(newSet)
-    cloneNode(set->root, &(newSet->root));
-  return newSet;
+// In-order traversal of the elements x with lo <= x < hi. Returns false
+// once an element not less than hi has been seen.
+static bool node_range(node_t *node, uintptr_t lo, uintptr_t hi,
+                       forall_fnc f, void *arg)
+{
+  for (size_t i = node_find(node, (void*)lo); i < node->n; i++) {
+    if (!node->leaf && !node_range(node->children[i], lo, hi, f, arg)) {
+      return false;
+    }
+    if ((uintptr_t)node->keys[i] >= hi) {
+      return false;
+    }
+    f(node->keys[i], arg);
+  }
+  return node->leaf || node_range(node->children[node->n], lo, hi, f, arg);
 }
 
-static void printNode(struct node *node, printer_fnc printer){
-  if(node){
-    if(node->left)
-      printNode(node->left, printer);
-    printer(node->elem);
-    if(node->right)
-      printNode(node->right, printer);
+void set_forall_range(set_t *set, void *lo, void *hi, forall_fnc f,
+                      void *arg)
+{
+  if (set && set->root) {
+    node_range(set->root, (uintptr_t)lo, (uintptr_t)hi, f, arg);
   }
 }
 
-void set_print(set_t *set, printer_fnc printer){
-  if(set)
-    printNode(set->root, printer);
+void set_forall(set_t *set, forall_fnc f, void *arg)
+{
+  set_forall_range(set, NULL, (void*)UINTPTR_MAX, f, arg);
 }
 
-static void node_destroy(struct node* node){
-  if(node){
-    node_destroy(node->left);
-    node_destroy(node->right);
-    FREE(node);
+typedef struct subset_arg {
+  set_t *super;
+  bool subset;
+} subset_arg_t;
+
+static void *subset_visit(void *elem, void *arg)
+{
+  subset_arg_t *s = arg;
+  if (s->subset && !set_elem(s->super, elem)) {
+    s->subset = false;
   }
+  return NULL;
 }
 
-void set_destroy(set_t *set){
-  if(set){
-    node_destroy(set->root);
-    FREE(set);
+bool set_subset(set_t *sub, set_t *super)
+{
+  if (!sub) {
+    return false;
+  }
+  if (set_size(sub) > set_size(super)) {
+    return false;
   }
+  subset_arg_t arg = { .super = super, .subset = true };
+  set_forall(sub, subset_visit, &arg);
+  return arg.subset;
 }
 
-static set_t *node_map(struct node *node, set_t *result, map_fnc f){
-  if(node){
-    set_add(result, f(node->elem));
-    node_map(node->left, result, f);
-    node_map(node->right, result, f);
+bool set_eq(set_t *set, set_t *other)
+{
+  return set_size(set) == set_size(other) && set_subset(set, other);
+}
+
+static node_t *node_clone(pony_ctx_t **ctx, node_t *from)
+{
+  node_t *to = node_mk(ctx, from->leaf);
+  to->n = from->n;
+  memcpy(to->keys, from->keys, from->n * sizeof(void*));
+  if (!from->leaf) {
+    for (size_t i = 0; i <= from->n; i++) {
+      to->children[i] = node_clone(ctx, from->children[i]);
+    }
   }
-  return result;
+  return to;
 }
 
-set_t *set_map(set_t *set, map_fnc f){
-  if(set)
-    return node_map(set->root, set_mk(), f);
-  else
+set_t *set_clone(pony_ctx_t **ctx, set_t *set)
+{
+  if (!set) {
     return NULL;
+  }
+  set_t *new_set = set_mk(ctx);
+  if (set->root) {
+    new_set->root = node_clone(ctx, set->root);
+    new_set->size = set->size;
+  }
+  return new_set;
 }
 
-static void node_forall(struct node *node, forall_fnc f, void *arg){
-  if(node){
-    f(node->elem, arg);
-    node_forall(node->left, f, arg);
-    node_forall(node->right, f, arg);
-  }
+static void *print_visit(void *elem, void *printer)
+{
+  ((printer_fnc)printer)(elem);
+  return NULL;
+}
+
+void set_print(set_t *set, printer_fnc printer)
+{
+  set_forall(set, print_visit, (void*)printer);
 }
 
-void set_forall(set_t *set, forall_fnc f, void *arg){
-  if(set)
-    node_forall(set->root, f, arg);
+typedef struct map_arg {
+  pony_ctx_t **ctx;
+  set_t *result;
+  map_fnc f;
+} map_arg_t;
+
+static void *map_visit(void *elem, void *arg)
+{
+  map_arg_t *m = arg;
+  set_add(m->ctx, m->result, m->f(elem));
+  return NULL;
 }
 
-static void node_forall_closure(struct node *node, closure_t *c){
-  if(node){
-    value_t args[1] = {ptr_to_val(node->elem)};
-    closure_call(c, args);
-    node_forall_closure(node->left, c);
-    node_forall_closure(node->right, c);
+set_t *set_map(pony_ctx_t **ctx, set_t *set, map_fnc f)
+{
+  if (!set) {
+    return NULL;
   }
+  map_arg_t arg = { .ctx = ctx, .result = set_mk(ctx), .f = f };
+  set_forall(set, map_visit, &arg);
+  return arg.result;
 }
 
-void set_forall_closure(set_t *set, closure_t *c){
-  if(set)
-    node_forall_closure(set->root, c);
+typedef struct closure_arg {
+  pony_ctx_t **ctx;
+  closure_t *c;
+} closure_arg_t;
+
+static void *closure_visit(void *elem, void *arg)
+{
+  closure_arg_t *c = arg;
+  value_t args[1] = { { .p = elem } };
+  closure_call(c->ctx, c->c, args);
+  return NULL;
 }
 
-static void *node_reduce(struct node *node, reduce_fnc f, void *acc){
-  if(!node)
-    return acc;
-  else{
-    void *left = node_reduce(node->left, f, acc);
-    void *mid  = f(node->elem, left);
-    return node_reduce(node->right, f, mid);
-  }
+void set_forall_closure(pony_ctx_t **ctx, set_t *set, closure_t *c)
+{
+  closure_arg_t arg = { .ctx = ctx, .c = c };
+  set_forall(set, closure_visit, &arg);
 }
 
-void *set_reduce(set_t *set, reduce_fnc f, void *init){
-  if(set)
-    return node_reduce(set->root, f, init);
-  else
+typedef struct reduce_arg {
+  reduce_fnc f;
+  void *acc;
+} reduce_arg_t;
+
+static void *reduce_visit(void *elem, void *arg)
+{
+  reduce_arg_t *r = arg;
+  r->acc = r->f(elem, r->acc);
+  return NULL;
+}
+
+void *set_reduce(set_t *set, reduce_fnc f, void *init)
+{
+  if (!set) {
     return NULL;
+  }
+  reduce_arg_t arg = { .f = f, .acc = init };
+  set_forall(set, reduce_visit, &arg);
+  return arg.acc;
 }
@@ -8,35 +8,56 @@
 #define __set_h__
 
 #include <stdbool.h>
+#include <stddef.h>
 #include "closure.h"
 
+/**
+ *  An ordered set of pointers, compared by address. The set is a
+ *  B-tree: elements are kept sorted in wide nodes, so lookups, insertions
+ *  and removals take O(log n) steps whatever order elements arrive in.
+ *  Sets are allocated on the pony heap and reclaimed by the GC; the
+ *  elements themselves are not traced.
+ */
 typedef struct set set_t;
 
-typedef void  (*printer_fnc)(void *elem); 
-typedef void *(*map_fnc)(void *elem); 
-typedef void *(*forall_fnc)(void *elem, void* arg); 
+typedef void  (*printer_fnc)(void *elem);
+typedef void *(*map_fnc)(void *elem);
+typedef void *(*forall_fnc)(void *elem, void* arg);
 typedef void *(*reduce_fnc)(void *elem, void *accumulator);
 
+extern pony_type_t set_type;
+
+void set_trace(pony_ctx_t *ctx, void *p);
+
 /**
- *  Create a new empty set. Use set_destroy"()" to free the allocated memory.
+ *  Create a new empty set.
  *  @return A new empty set
  */
-set_t *set_mk(void);
+set_t *set_mk(pony_ctx_t **ctx);
+
+/**
+ *  Create a set from an array of elements in one go, without searching
+ *  for the place of each element.
+ *  @param elems The elements, in strictly increasing order of address
+ *  @param n The number of elements in \p elems
+ *  @return A new set holding the elements of \p elems
+ */
+set_t *set_from_sorted(pony_ctx_t **ctx, void *elems[], size_t n);
 
 /**
  *  Insert an element in a set.
  *  @param set The set to be extended
  *  @param elem The element to be inserted
  *  @return 0 if \p elem was already \p set, otherwise a non-zero value
- */ 
-bool set_add(set_t *set, void *elem);
+ */
+bool set_add(pony_ctx_t **ctx, set_t *set, void *elem);
 
 /**
  *  Test an element for set membership.
  *  @param set The set to be searched
  *  @param elem The element sought for
  *  @return 0 if \p elem was not in \p set, otherwise a non-zero value
- */ 
+ */
 bool set_elem(set_t *set, void *elem);
 
 /**
@@ -44,15 +65,21 @@ bool set_elem(set_t *set, void *elem);
  *  @param set The set to be contracted
  *  @param elem the element to be deleted
  *  @return 0 if \p elem was not in \p set, otherwise a non-zero value
- */ 
+ */
 bool set_remove(set_t *set, void *elem);
 
+/**
+ *  @param set
+ *  @return The number of elements in \p set
+ */
+size_t set_size(set_t *set);
+
 /**
  *  Test a set for subset relation.
  *  @param sub
  *  @param super
  *  @return 0 if \p sub is not a subset of \p super, otherwise a non-zero value
- */ 
+ */
 bool set_subset(set_t *sub, set_t *super);
 
 /**
@@ -60,49 +87,51 @@ bool set_subset(set_t *sub, set_t *super);
  *  @param set
  *  @param other
  *  @return 0 if \p set and \p other do not contain exactly the same elements, otherwise a non-zero value
- */ 
+ */
 bool set_eq(set_t *set, set_t *other);
 
 /**
  *  Create a copy of a set.
  *  @param set The set to be cloned
  *  @return A new set with all elements of \p set copied
- */ 
-set_t *set_clone(set_t *set);
+ */
+set_t *set_clone(pony_ctx_t **ctx, set_t *set);
 
 /**
- *  Print a set. 
+ *  Print a set, in order.
  *  @param set The set to be printed
  *  @param print A function that prints a single element of the set
- */ 
+ */
 void set_print(set_t *set, printer_fnc print);
 
-/**
- *  Remove a set (but not its elements) from memory
- *  @param set The set to be destroyed
- */ 
-void set_destroy(set_t *set);
-
 /**
  *  Map over all the elements of a set.
  *  @param set The set to be mapped over
  *  @param f A function that maps (with or without side-effects) a single element of the set to a new one
  *  @return The set {\p f (x) | x <-- \p set}
- */ 
-set_t *set_map(set_t *set, map_fnc f);
+ */
+set_t *set_map(pony_ctx_t **ctx, set_t *set, map_fnc f);
 
 /**
- *  Like a map over a set where the return type of f is void.
+ *  Like a map over a set where the return type of f is void. The
+ *  elements are visited in order.
  *  @param set The set to be mapped over
  *  @param f A function that maps (with or without side-effects) a single element of the set to a new one
  *  @param arg An argument to be supplied as the last argument to each f
  */
 void set_forall(set_t *set, forall_fnc f, void *arg);
 
-/** 
+/**
+ *  Like set_forall, but only visits the elements x with
+ *  \p lo <= x < \p hi. Finding the first one takes O(log n) steps.
+ */
+void set_forall_range(set_t *set, void *lo, void *hi, forall_fnc f,
+                      void *arg);
+
+/**
  * @see set_forall, but uses a closure
  */
-void set_forall_closure(set_t *set, closure_t *c);
+void set_forall_closure(pony_ctx_t **ctx, set_t *set, closure_t *c);
 
 /**
  *  Reduce a set to a single element
@@ -110,7 +139,7 @@ void set_forall_closure(set_t *set, closure_t *c);
  *  @param f A binary function
  *  @param init The initial accumulator value
  *  @return \p f (xn, \p f (..., \p f (x2, \p f (x1, \p init))...))
- */ 
+ */
 void *set_reduce(set_t *set, reduce_fnc f, void *init);
 
 #endif
@@ -1,142 +1,396 @@
 #include "stream.h"
 #include "future.h"
+#include "../libponyrt/sched/scheduler.h"
 #include <stdio.h>
 #include <assert.h>
 #include <inttypes.h>
 
-struct scons{
-  bool eos;
-  encore_arg_t element;
+// Elements are yielded into fixed-size chunks. A chunk becomes visible to
+// consumers in one go when it is sealed: when it is full, when the stream
+// is closed, or when the producer stops running (it blocks, suspends or
+// finishes its message). Consumers therefore only block (and are woken)
+// once per chunk instead of once per element.
+//
+// Chunks are traced as immutable objects. Other actors only ever hold the
+// chunk itself, and its owner keeps what it refers to (the elements and the
+// next chunk) alive for as long as any of them does, as it does for any
+// immutable object. The producer owns every chunk but the first, which is
+// made together with the stream by the actor that called the stream method.
+// The contents of a chunk published by an actor that does not own it are
+// sent to the owner, like the value of a future, and received back by the
+// finaliser of the chunk.
+#define STREAM_CHUNK_SIZE 64
+
+// How many sealed chunks the producer may run ahead of its consumers. When
+// no consumer has reached the chunk this far back, the producer awaits it.
+#define STREAM_WINDOW 8
+
+extern void encore_future_gc_acquireactor(pony_ctx_t* ctx, pony_actor_t* actor);
+extern void encore_future_gc_acquireobject(pony_ctx_t* ctx, void* p,
+    pony_type_t *t, int mutability);
+static void stream_gc_acquire(pony_ctx_t* ctx)
+{
+  ctx->trace_object = encore_future_gc_acquireobject;
+  ctx->trace_actor = encore_future_gc_acquireactor;
+}
+
+typedef struct stream_chunk stream_chunk_t;
+typedef struct stream_cursor stream_cursor_t;
+
+typedef struct stream_element
+{
+  encore_arg_t value;
   pony_type_t *type;
-  stream_t *next;
+} stream_element_t;
+
+struct stream_chunk
+{
+  pony_type_t *chunk_type;
+  // The actor that made the chunk
+  pony_actor_t *owner;
+  // Number of elements. Written by the producer only, and final once the
+  // chunk is sealed or closed
+  size_t size;
+  // Set when the chunk is sealed; the stream continues in `next`
+  stream_chunk_t *next;
+  // Set when the stream ends after the elements of this chunk
+  bool closed;
+  // Set when the contents were sent to the owner as the chunk was sealed
+  bool sent;
+  // Set by the first consumer that reads from this chunk
+  bool reached;
+  // Fulfilled when the chunk is sealed or closed
+  future_t *ready;
+  // Fulfilled when `reached` is set
+  future_t *taken;
+  stream_element_t elements[STREAM_CHUNK_SIZE];
 };
 
-void scons_trace(pony_ctx_t *ctx, void *p)
+// A position in a stream. This is what a stream_t points to
+struct stream_cursor
 {
-  assert(p);
-  struct scons *scons = p;
-  if (!scons->eos) {
-    pony_type_t *type = scons->type;
-    if(type == ENCORE_ACTIVE){
-      encore_trace_actor(ctx, scons->element.p);
-    } else if(type != ENCORE_PRIMITIVE){
-      encore_trace_object(ctx, scons->element.p, type->trace);
-    }
-    encore_trace_object(ctx, scons->next, future_trace);
+  stream_chunk_t *chunk;
+  size_t index;
+  // Producer only: a chunk STREAM_WINDOW (or fewer) chunks behind `chunk`
+  stream_chunk_t *lag;
+  size_t ahead;
+};
+
+// The chunk the producer running on this thread has not sealed yet
+static __pony_thread_local stream_chunk_t *pending = NULL;
+
+static void stream_chunk_trace(pony_ctx_t *ctx, void *p);
+static void stream_chunk_finalizer(void *p);
+
+static pony_type_t stream_chunk_type = {
+  .id = ID_STREAM,
+  .size = sizeof(stream_chunk_t),
+  .trace = &stream_chunk_trace,
+  .final = &stream_chunk_finalizer,
+};
+
+static void chunk_trace(pony_ctx_t *ctx, stream_chunk_t *chunk)
+{
+  if (chunk) {
+    pony_traceknown(ctx, chunk, &stream_chunk_type, PONY_TRACE_IMMUTABLE);
   }
 }
 
-static pony_type_t scons_type = {
-  .id = ID_SCONS,
-  .size = sizeof(struct scons),
-  .trace = scons_trace,
-};
+static void element_trace(pony_ctx_t *ctx, stream_element_t *element)
+{
+  if (element->type == ENCORE_ACTIVE) {
+    encore_trace_actor(ctx, element->value.p);
+  } else if (element->type != ENCORE_PRIMITIVE) {
+    encore_trace_known(ctx, element->value.p, element->type);
+  }
+}
 
-pony_type_t *get_scons_type()
+static void chunk_trace_contents(pony_ctx_t *ctx, stream_chunk_t *chunk)
 {
-  return &scons_type;
+  for (size_t i = 0; i < chunk->size; i++) {
+    element_trace(ctx, &chunk->elements[i]);
+  }
+  chunk_trace(ctx, chunk->next);
+}
+
+static void stream_chunk_trace(pony_ctx_t *ctx, void *p)
+{
+  assert(p);
+  stream_chunk_t *chunk = p;
+  encore_trace_object(ctx, chunk->ready, future_trace);
+  encore_trace_object(ctx, chunk->taken, future_trace);
+
+  // The first chunk may be filled by another actor while its owner traces
+  // it; its contents are only safe to read once it is sealed
+  if (__atomic_load_n(&chunk->next, __ATOMIC_ACQUIRE) ||
+      __atomic_load_n(&chunk->closed, __ATOMIC_ACQUIRE)) {
+    chunk_trace_contents(ctx, chunk);
+  }
+}
+
+static void stream_chunk_finalizer(void *p)
+{
+  stream_chunk_t *chunk = p;
+  if (chunk->sent) {
+    pony_ctx_t *cctx = pony_ctx();
+    pony_gc_recv(cctx);
+    chunk_trace_contents(cctx, chunk);
+    // note the asymmetry with send, as for the value of a future
+    ponyint_gc_handlestack(cctx);
+  }
 }
 
 void stream_trace(pony_ctx_t *ctx, void *p)
 {
-  future_trace(ctx, p);
+  assert(p);
+  stream_cursor_t *cursor = p;
+  chunk_trace(ctx, cursor->chunk);
+  chunk_trace(ctx, cursor->lag);
 }
 
-struct scons *scons_mk(pony_ctx_t *ctx, pony_type_t *type){
-  struct scons *scons = encore_alloc(ctx, sizeof(struct scons));
-  scons->eos = false;
-  scons->element = (value_t) {.p = NULL};
-  scons->type = type;
-  scons->next = NULL;
-  return scons;
+// Take part in the ownership of a chunk published by the producer
+static void chunk_acquire(pony_ctx_t *ctx, stream_chunk_t *chunk)
+{
+  stream_gc_acquire(ctx);
+  chunk_trace(ctx, chunk);
+  pony_acquire_done(ctx);
 }
 
-// For debugging
-__attribute__ ((unused))
-static void scons_print(struct scons *scons){
-  printf("struct scons@%p{\n", scons);
-  printf("  eos     = %s\n", scons->eos? "true": "false");
-  printf("  element = %" PRIdPTR "\n", scons->element.i);
-  printf("  type    = %p\n", scons->type);
-  printf("  next    = %p\n", scons->next);
-  printf("}\n");
+static stream_chunk_t *chunk_mk(pony_ctx_t **ctx)
+{
+  pony_ctx_t *cctx = *ctx;
+  stream_chunk_t *chunk = pony_alloc_final(cctx, sizeof(stream_chunk_t));
+  chunk->chunk_type = &stream_chunk_type;
+  chunk->owner = cctx->current;
+  chunk->size = 0;
+  chunk->next = NULL;
+  chunk->closed = false;
+  chunk->sent = false;
+  chunk->reached = false;
+  chunk->ready = future_mk(ctx, ENCORE_PRIMITIVE);
+  chunk->taken = future_mk(ctx, ENCORE_PRIMITIVE);
+  return chunk;
 }
 
-stream_t *stream_mk(pony_ctx_t **ctx)
+static stream_cursor_t *cursor_mk(pony_ctx_t *ctx, stream_chunk_t *chunk,
+        size_t index)
 {
-  return future_mk(ctx, &scons_type);
+  stream_cursor_t *cursor = encore_alloc(ctx, sizeof(stream_cursor_t));
+  cursor->chunk = chunk;
+  cursor->index = index;
+  cursor->lag = NULL;
+  cursor->ahead = 0;
+  return cursor;
 }
 
-stream_t *stream_put(pony_ctx_t **ctx, stream_t *s, encore_arg_t value,
-        pony_type_t *type)
+// Make the elements of a chunk visible, either followed by `next` or by
+// the end of the stream
+static void chunk_publish(pony_ctx_t **ctx, stream_chunk_t *chunk,
+        stream_chunk_t *next)
 {
-  future_t *fut = future_mk(ctx, &scons_type);
-  struct scons *scons = scons_mk(*ctx, type);
-  scons->element = value;
-  scons->next = fut;
-  future_fulfil(ctx, (future_t *)s, (encore_arg_t){ .p = scons });
-  return fut;
+  pony_ctx_t *cctx = *ctx;
+  if (chunk->owner != cctx->current) {
+    pony_gc_send(cctx);
+    for (size_t i = 0; i < chunk->size; i++) {
+      element_trace(cctx, &chunk->elements[i]);
+    }
+    chunk_trace(cctx, next);
+    pony_send_done(cctx);
+    chunk->sent = true;
+  }
+
+  if (next) {
+    __atomic_store_n(&chunk->next, next, __ATOMIC_RELEASE);
+  } else {
+    __atomic_store_n(&chunk->closed, true, __ATOMIC_RELEASE);
+  }
+  future_fulfil(ctx, chunk->ready, (encore_arg_t){ .p = NULL });
+
+  if (pending == chunk) {
+    pending = NULL;
+  }
 }
 
-encore_arg_t stream_get(pony_ctx_t **ctx, stream_t *s)
+static stream_chunk_t *chunk_seal(pony_ctx_t **ctx, stream_chunk_t *chunk)
 {
-  struct scons *scons = future_get_actor(ctx, (future_t *)s).p;
-  return scons->element;
+  stream_chunk_t *next = chunk_mk(ctx);
+  chunk_publish(ctx, chunk, next);
+  return next;
 }
 
-stream_t *stream_get_next(pony_ctx_t **ctx, stream_t *s)
+void stream_flush(pony_ctx_t **ctx)
 {
-  struct scons *scons = future_get_actor(ctx, (future_t *)s).p;
-  return scons->next;
+  if (pending) {
+    chunk_seal(ctx, pending);
+  }
 }
 
-void stream_close(pony_ctx_t **ctx, stream_t *s)
+// The producer's cursor may point to a chunk that was sealed behind its
+// back by stream_flush; move it to the chunk that is still open
+static stream_cursor_t *producer_cursor(pony_ctx_t **ctx,
+        stream_cursor_t *cursor)
 {
-  struct scons *scons = scons_mk(*ctx, NULL);
-  scons->eos = true;
-  future_fulfil(ctx, (future_t *)s, (encore_arg_t){ .p = scons });
+  stream_chunk_t *chunk = cursor->chunk;
+  if (chunk->next == NULL) {
+    return cursor;
+  }
+
+  size_t ahead = cursor->ahead;
+  stream_chunk_t *lag = cursor->lag ? cursor->lag : chunk;
+  while (chunk->next) {
+    chunk = chunk->next;
+    if (ahead < STREAM_WINDOW) {
+      ahead++;
+    } else {
+      lag = lag->next;
+    }
+  }
+
+  stream_cursor_t *next = cursor_mk(*ctx, chunk, 0);
+  next->lag = lag;
+  next->ahead = ahead;
+
+  // Consumers have not even started on the chunk STREAM_WINDOW chunks
+  // back: wait for them before producing more. The producer awaits rather
+  // than blocks, so it can still serve the messages its consumers may be
+  // waiting for.
+  if (ahead == STREAM_WINDOW &&
+      !__atomic_load_n(&lag->reached, __ATOMIC_ACQUIRE)) {
+    future_await(ctx, lag->taken);
+  }
+
+  return next;
 }
 
-bool stream_eos(pony_ctx_t **ctx, stream_t *s)
+// Record that a consumer has reached `chunk`, letting the producer run
+// further ahead
+static void chunk_reach(pony_ctx_t **ctx, stream_chunk_t *chunk)
+{
+  if (!__atomic_load_n(&chunk->reached, __ATOMIC_RELAXED) &&
+      !__atomic_exchange_n(&chunk->reached, true, __ATOMIC_ACQ_REL)) {
+    future_fulfil(ctx, chunk->taken, (encore_arg_t){ .p = NULL });
+  }
+}
+
+// Find the chunk holding position `*index` of `chunk`, blocking until the
+// producer has sealed or closed it. Returns NULL at the end of the stream.
+static stream_chunk_t *stream_wait(pony_ctx_t **ctx, stream_chunk_t *chunk,
+        size_t *index)
 {
-  struct scons *scons = future_get_actor(ctx, (future_t *)s).p;
-  return scons->eos;
+  while (true) {
+    stream_chunk_t *next = __atomic_load_n(&chunk->next, __ATOMIC_ACQUIRE);
+    bool closed = __atomic_load_n(&chunk->closed, __ATOMIC_ACQUIRE);
+
+    if (next == NULL && !closed) {
+      future_get_actor(ctx, chunk->ready);
+      continue;
+    }
+
+    if (*index < chunk->size) {
+      chunk_reach(ctx, chunk);
+      return chunk;
+    }
+
+    if (closed) {
+      return NULL;
+    }
+
+    chunk_acquire(*ctx, next);
+    chunk = next;
+    *index = 0;
+  }
 }
 
-stream_t *stream_put_fut(pony_ctx_t **ctx, future_t* fut, stream_t *s,
-                            encore_arg_t value, pony_type_t *type){
-  struct scons *scons = scons_mk(*ctx,type);
-  scons->element = value;
-  scons->next = fut;
-  future_fulfil(ctx,(future_t *)s, (encore_arg_t){ .p = scons });
-  return fut;
+// For debugging
+__attribute__ ((unused))
+static void stream_print(stream_cursor_t *cursor){
+  stream_chunk_t *chunk = cursor->chunk;
+  printf("struct stream_cursor@%p{\n", cursor);
+  printf("  chunk   = %p\n", chunk);
+  printf("  index   = %zu\n", cursor->index);
+  printf("  size    = %zu\n", chunk->size);
+  printf("  next    = %p\n", chunk->next);
+  printf("  closed  = %s\n", chunk->closed? "true": "false");
+  printf("}\n");
+}
+
+stream_t *stream_mk(pony_ctx_t **ctx)
+{
+  return cursor_mk(*ctx, chunk_mk(ctx), 0);
 }
 
-bool scons_eos(pony_ctx_t **ctx, scons_t *scons){
-  (void)ctx;
-  return scons->eos;
+stream_t *stream_put(pony_ctx_t **ctx, stream_t *s, encore_arg_t value,
+        pony_type_t *type)
+{
+  stream_cursor_t *cursor = producer_cursor(ctx, s);
+  stream_chunk_t *chunk = cursor->chunk;
+
+  if (pending != chunk) {
+    stream_flush(ctx);
+    pending = chunk;
+  }
+
+  chunk->elements[chunk->size++] = (stream_element_t) {
+    .value = value, .type = type
+  };
+
+  if (chunk->size == STREAM_CHUNK_SIZE) {
+    chunk_seal(ctx, chunk);
+    return producer_cursor(ctx, cursor);
+  }
+
+  return cursor;
 }
 
-encore_arg_t scons_element(pony_ctx_t **ctx, scons_t *scons){
-  (void)ctx;
-  return scons->element;
+encore_arg_t stream_get(pony_ctx_t **ctx, stream_t *s)
+{
+  stream_cursor_t *cursor = s;
+  size_t index = cursor->index;
+  stream_chunk_t *chunk = stream_wait(ctx, cursor->chunk, &index);
+  if (chunk == NULL) {
+    return (encore_arg_t){ .p = NULL };
+  }
+
+  stream_element_t *element = &chunk->elements[index];
+  if (element->type != ENCORE_PRIMITIVE) {
+    pony_ctx_t *cctx = *ctx;
+    stream_gc_acquire(cctx);
+    element_trace(cctx, element);
+    pony_acquire_done(cctx);
+  }
+
+  return element->value;
 }
 
-stream_t *scons_next(pony_ctx_t **ctx, scons_t *scons){
-  (void)ctx;
-  return scons->next;
+stream_t *stream_get_next(pony_ctx_t **ctx, stream_t *s)
+{
+  stream_cursor_t *cursor = s;
+  size_t index = cursor->index;
+  stream_chunk_t *chunk = stream_wait(ctx, cursor->chunk, &index);
+  if (chunk == NULL) {
+    return NULL;
+  }
+
+  // Step into the next chunk right away if it is known, so that it is
+  // acquired once rather than on every use of the returned stream
+  stream_chunk_t *next = __atomic_load_n(&chunk->next, __ATOMIC_ACQUIRE);
+  if (index + 1 == chunk->size && next) {
+    chunk_acquire(*ctx, next);
+    return cursor_mk(*ctx, next, 0);
+  }
+
+  return cursor_mk(*ctx, chunk, index + 1);
 }
 
-scons_t *scons_end(pony_ctx_t **ctx){
-  struct scons *scons = scons_mk(*ctx, NULL);
-  scons->eos = true;
-  return scons;
+void stream_close(pony_ctx_t **ctx, stream_t *s)
+{
+  stream_cursor_t *cursor = producer_cursor(ctx, s);
+  chunk_publish(ctx, cursor->chunk, NULL);
 }
 
-scons_t *scons_put_fut(pony_ctx_t **ctx, stream_t *s,
-                            encore_arg_t value, pony_type_t *type){
-  struct scons *scons = scons_mk(*ctx,type);
-  scons->element = value;
-  scons->next = (future_t*)s;
-  return scons;
+bool stream_eos(pony_ctx_t **ctx, stream_t *s)
+{
+  stream_cursor_t *cursor = s;
+  size_t index = cursor->index;
+  return stream_wait(ctx, cursor->chunk, &index) == NULL;
 }
@@ -7,37 +7,6 @@
 typedef void stream_t;
 #include "encore.h"
 
-typedef struct scons scons_t;
-
-bool scons_eos(pony_ctx_t **ctx, scons_t *scons);
-
-encore_arg_t scons_element(pony_ctx_t **ctx, scons_t *scons);
-
-stream_t *scons_next(pony_ctx_t **ctx, scons_t *scons);
-
-scons_t *scons_end(pony_ctx_t **ctx);
-
-scons_t *scons_put_fut(pony_ctx_t **ctx, stream_t *s,
-                            encore_arg_t value, pony_type_t *type);
-
-pony_type_t *get_scons_type();
-
-void scons_trace(pony_ctx_t *ctx, void *p);
-
-/**
- *  Put a value in an EXISTING stream
- *
- *  @param s A stream
- *  @param fut An EXISTING stream
- *  @param value The value to be put in the stream
- *  @param type The runtime type of \p value
- *  @return The (empty) head of \p s
- */
-stream_t *stream_put_fut(pony_ctx_t **ctx, future_t* fut, stream_t *s,
-                         encore_arg_t value, pony_type_t *type);
-
-struct scons *scons_mk(pony_ctx_t *ctx, pony_type_t *type);
-
 /**
  *  Create a new stream
  *
@@ -52,7 +21,7 @@ stream_t *stream_mk(pony_ctx_t **ctx);
  *  @param s A stream
  *  @param value The value to be put in the stream
  *  @param type The runtime type of \p value
- *  @return The (empty) head of \p s
+ *  @return Where the producer should put the next value
  */
 stream_t *stream_put(pony_ctx_t **ctx, stream_t *s, encore_arg_t value,
         pony_type_t *type);
@@ -94,6 +63,15 @@ void stream_close(pony_ctx_t **ctx, stream_t *s);
  */
 bool stream_eos(pony_ctx_t **ctx, stream_t *s);
 
+/**
+ *  Make the elements the current producer has put in a stream visible
+ *
+ *  Elements are only handed to consumers a chunk at a time. This is
+ *  called whenever the producer stops running so that consumers never
+ *  wait for elements that have already been produced.
+ */
+void stream_flush(pony_ctx_t **ctx);
+
 /**
  * Trace function for streams
  */
@@ -0,0 +1,413 @@
+#include "stringops.h"
+#include <string.h>
+
+// The kernels come in three flavours: AVX2 (picked at run time when the
+// processor has it), SSE2 (always present on x86-64) and plain C for the
+// remaining bytes and other architectures.
+#if defined(__SSE2__)
+#include <immintrin.h>
+#define STRING_SSE2
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#define STRING_AVX2
+#endif
+#endif
+
+#ifdef STRING_AVX2
+static bool has_avx2()
+{
+  static int avx2 = -1;
+  if (avx2 < 0) {
+    __builtin_cpu_init();
+    avx2 = __builtin_cpu_supports("avx2") ? 1 : 0;
+  }
+  return avx2;
+}
+#endif
+
+static inline unsigned char fold(unsigned char c)
+{
+  return (unsigned char)(c - 'A') < 26 ? c | 0x20 : c;
+}
+
+static inline bool is_space(unsigned char c)
+{
+  return c == ' ' || (unsigned char)(c - '\t') < 5;
+}
+
+// ===============================================================
+// Search
+// ===============================================================
+
+static int64_t find_scalar(const char *s, size_t len, const char *p,
+                           size_t plen, size_t i)
+{
+  while (i + plen <= len) {
+    const char *c = memchr(s + i, p[0], len - plen + 1 - i);
+    if (c == NULL) {
+      return -1;
+    }
+    i = c - s;
+    if (memcmp(s + i + 1, p + 1, plen - 1) == 0) {
+      return i;
+    }
+    i++;
+  }
+  return -1;
+}
+
+// Candidates are positions where both the first and the last byte of the
+// pattern match; only those are compared in full.
+#ifdef STRING_SSE2
+static int64_t find_sse2(const char *s, size_t len, const char *p,
+                         size_t plen, size_t i)
+{
+  const __m128i first = _mm_set1_epi8(p[0]);
+  const __m128i last = _mm_set1_epi8(p[plen - 1]);
+  for (; i + plen - 1 + 16 <= len; i += 16) {
+    __m128i block_first = _mm_loadu_si128((const __m128i*)(s + i));
+    __m128i block_last = _mm_loadu_si128((const __m128i*)(s + i + plen - 1));
+    unsigned mask = _mm_movemask_epi8(
+        _mm_and_si128(_mm_cmpeq_epi8(first, block_first),
+                      _mm_cmpeq_epi8(last, block_last)));
+    while (mask) {
+      unsigned bit = __builtin_ctz(mask);
+      if (memcmp(s + i + bit + 1, p + 1, plen - 2) == 0) {
+        return i + bit;
+      }
+      mask &= mask - 1;
+    }
+  }
+  return find_scalar(s, len, p, plen, i);
+}
+#endif
+
+#ifdef STRING_AVX2
+__attribute__ ((target("avx2")))
+static int64_t find_avx2(const char *s, size_t len, const char *p,
+                         size_t plen, size_t i)
+{
+  const __m256i first = _mm256_set1_epi8(p[0]);
+  const __m256i last = _mm256_set1_epi8(p[plen - 1]);
+  for (; i + plen - 1 + 32 <= len; i += 32) {
+    __m256i block_first = _mm256_loadu_si256((const __m256i*)(s + i));
+    __m256i block_last =
+      _mm256_loadu_si256((const __m256i*)(s + i + plen - 1));
+    unsigned mask = _mm256_movemask_epi8(
+        _mm256_and_si256(_mm256_cmpeq_epi8(first, block_first),
+                         _mm256_cmpeq_epi8(last, block_last)));
+    while (mask) {
+      unsigned bit = __builtin_ctz(mask);
+      if (memcmp(s + i + bit + 1, p + 1, plen - 2) == 0) {
+        return i + bit;
+      }
+      mask &= mask - 1;
+    }
+  }
+  return find_sse2(s, len, p, plen, i);
+}
+#endif
+
+int64_t string_find(const char *s, size_t len, const char *p, size_t plen,
+                    size_t from)
+{
+  if (from > len || plen > len - from) {
+    return -1;
+  }
+  if (plen == 0) {
+    return from;
+  }
+  if (plen == 1) {
+    const char *c = memchr(s + from, p[0], len - from);
+    return c ? c - s : -1;
+  }
+
+#ifdef STRING_AVX2
+  if (len - from >= 64 && has_avx2()) {
+    return find_avx2(s, len, p, plen, from);
+  }
+#endif
+#ifdef STRING_SSE2
+  return find_sse2(s, len, p, plen, from);
+#else
+  return find_scalar(s, len, p, plen, from);
+#endif
+}
+
+static bool equal_ignore_case(const char *a, const char *b, size_t n)
+{
+  for (size_t i = 0; i < n; i++) {
+    if (fold(a[i]) != fold(b[i])) {
+      return false;
+    }
+  }
+  return true;
+}
+
+int64_t string_find_ignore_case(const char *s, size_t len, const char *p,
+                                size_t plen, size_t from)
+{
+  if (from > len || plen > len - from) {
+    return -1;
+  }
+  if (plen == 0) {
+    return from;
+  }
+
+  size_t i = from;
+  unsigned char p0 = fold(p[0]);
+#ifdef STRING_SSE2
+  // Setting bit 5 maps exactly 'A' and 'a' to 'a' (and so on), so the
+  // filter lets both cases of a letter through and nothing else
+  const char case_bit = (unsigned char)(p0 - 'a') < 26 ? 0x20 : 0;
+  const __m128i first = _mm_set1_epi8(p0);
+  const __m128i first_mask = _mm_set1_epi8(case_bit);
+  for (; i + plen - 1 + 16 <= len; i += 16) {
+    __m128i block = _mm_loadu_si128((const __m128i*)(s + i));
+    unsigned mask = _mm_movemask_epi8(
+        _mm_cmpeq_epi8(first, _mm_or_si128(block, first_mask)));
+    while (mask) {
+      unsigned bit = __builtin_ctz(mask);
+      if (equal_ignore_case(s + i + bit + 1, p + 1, plen - 1)) {
+        return i + bit;
+      }
+      mask &= mask - 1;
+    }
+  }
+#endif
+  for (; i + plen <= len; i++) {
+    if (fold(s[i]) == p0 && equal_ignore_case(s + i + 1, p + 1, plen - 1)) {
+      return i;
+    }
+  }
+  return -1;
+}
+
+size_t string_count(const char *s, size_t len, const char *p, size_t plen)
+{
+  size_t count = 0;
+  int64_t i = string_find(s, len, p, plen, 0);
+  while (i >= 0) {
+    count++;
+    i = string_find(s, len, p, plen, i + plen);
+  }
+  return count;
+}
+
+// ===============================================================
+// Case conversion
+// ===============================================================
+
+// Flips bit 5 of every byte in [lo, hi]. Bytes outside ASCII are negative
+// as signed chars and so never in range.
+static void convert_case(char *dst, const char *src, size_t len,
+                         char lo, char hi)
+{
+  size_t i = 0;
+#ifdef STRING_SSE2
+  const __m128i below = _mm_set1_epi8(lo - 1);
+  const __m128i above = _mm_set1_epi8(hi + 1);
+  const __m128i flip = _mm_set1_epi8(0x20);
+  for (; i + 16 <= len; i += 16) {
+    __m128i block = _mm_loadu_si128((const __m128i*)(src + i));
+    __m128i in_range = _mm_and_si128(_mm_cmpgt_epi8(block, below),
+                                     _mm_cmpgt_epi8(above, block));
+    block = _mm_xor_si128(block, _mm_and_si128(in_range, flip));
+    _mm_storeu_si128((__m128i*)(dst + i), block);
+  }
+#endif
+  for (; i < len; i++) {
+    char c = src[i];
+    dst[i] = (c >= lo && c <= hi) ? c ^ 0x20 : c;
+  }
+}
+
+#ifdef STRING_AVX2
+__attribute__ ((target("avx2")))
+static void convert_case_avx2(char *dst, const char *src, size_t len,
+                              char lo, char hi)
+{
+  const __m256i below = _mm256_set1_epi8(lo - 1);
+  const __m256i above = _mm256_set1_epi8(hi + 1);
+  const __m256i flip = _mm256_set1_epi8(0x20);
+  size_t i = 0;
+  for (; i + 32 <= len; i += 32) {
+    __m256i block = _mm256_loadu_si256((const __m256i*)(src + i));
+    __m256i in_range = _mm256_and_si256(_mm256_cmpgt_epi8(block, below),
+                                        _mm256_cmpgt_epi8(above, block));
+    block = _mm256_xor_si256(block, _mm256_and_si256(in_range, flip));
+    _mm256_storeu_si256((__m256i*)(dst + i), block);
+  }
+  convert_case(dst + i, src + i, len - i, lo, hi);
+}
+#endif
+
+void string_to_upper(char *dst, const char *src, size_t len)
+{
+#ifdef STRING_AVX2
+  if (len >= 64 && has_avx2()) {
+    convert_case_avx2(dst, src, len, 'a', 'z');
+    return;
+  }
+#endif
+  convert_case(dst, src, len, 'a', 'z');
+}
+
+void string_to_lower(char *dst, const char *src, size_t len)
+{
+#ifdef STRING_AVX2
+  if (len >= 64 && has_avx2()) {
+    convert_case_avx2(dst, src, len, 'A', 'Z');
+    return;
+  }
+#endif
+  convert_case(dst, src, len, 'A', 'Z');
+}
+
+// ===============================================================
+// Whitespace
+// ===============================================================
+
+#ifdef STRING_SSE2
+// A mask with a bit set for every whitespace byte of the block
+static inline unsigned space_mask(__m128i block)
+{
+  const __m128i space = _mm_set1_epi8(' ');
+  const __m128i below = _mm_set1_epi8('\t' - 1);
+  const __m128i above = _mm_set1_epi8('\r' + 1);
+  __m128i controls = _mm_and_si128(_mm_cmpgt_epi8(block, below),
+                                   _mm_cmpgt_epi8(above, block));
+  return _mm_movemask_epi8(_mm_or_si128(controls,
+                                        _mm_cmpeq_epi8(block, space)));
+}
+#endif
+
+void string_trim(const char *s, size_t len, size_t *start, size_t *stop)
+{
+  size_t i = 0;
+#ifdef STRING_SSE2
+  for (; i + 16 <= len; i += 16) {
+    unsigned mask = space_mask(_mm_loadu_si128((const __m128i*)(s + i)));
+    if (mask != 0xFFFF) {
+      i += __builtin_ctz(~mask);
+      break;
+    }
+  }
+#endif
+  while (i < len && is_space(s[i])) {
+    i++;
+  }
+
+  size_t j = len;
+#ifdef STRING_SSE2
+  for (; j >= i + 16; j -= 16) {
+    unsigned mask = space_mask(_mm_loadu_si128((const __m128i*)(s + j - 16)));
+    if (mask != 0xFFFF) {
+      j -= __builtin_clz(~mask & 0xFFFF) - 16;
+      break;
+    }
+  }
+#endif
+  while (j > i && is_space(s[j - 1])) {
+    j--;
+  }
+
+  *start = i;
+  *stop = j;
+}
+
+// ===============================================================
+// UTF-8
+// ===============================================================
+
+static size_t skip_ascii(const unsigned char *s, size_t len, size_t i)
+{
+#ifdef STRING_SSE2
+  for (; i + 16 <= len; i += 16) {
+    unsigned mask = _mm_movemask_epi8(_mm_loadu_si128((const __m128i*)(s + i)));
+    if (mask) {
+      return i + __builtin_ctz(mask);
+    }
+  }
+#endif
+  while (i < len && s[i] < 0x80) {
+    i++;
+  }
+  return i;
+}
+
+#ifdef STRING_AVX2
+__attribute__ ((target("avx2")))
+static size_t skip_ascii_avx2(const unsigned char *s, size_t len, size_t i)
+{
+  for (; i + 32 <= len; i += 32) {
+    unsigned mask =
+      _mm256_movemask_epi8(_mm256_loadu_si256((const __m256i*)(s + i)));
+    if (mask) {
+      return i + __builtin_ctz(mask);
+    }
+  }
+  return skip_ascii(s, len, i);
+}
+#endif
+
+// The length of the well-formed sequence starting at s[i] (which is not
+// ASCII), or 0 if it is malformed. Overlong encodings, surrogates and code
+// points above U+10FFFF are malformed.
+static size_t utf8_sequence(const unsigned char *s, size_t len, size_t i)
+{
+  unsigned char c = s[i];
+  unsigned char lo = 0x80;
+  unsigned char hi = 0xBF;
+  size_t n;
+  if (c >= 0xC2 && c <= 0xDF) {
+    n = 2;
+  } else if (c == 0xE0) {
+    n = 3; lo = 0xA0;
+  } else if (c == 0xED) {
+    n = 3; hi = 0x9F;
+  } else if (c >= 0xE1 && c <= 0xEF) {
+    n = 3;
+  } else if (c == 0xF0) {
+    n = 4; lo = 0x90;
+  } else if (c == 0xF4) {
+    n = 4; hi = 0x8F;
+  } else if (c >= 0xF1 && c <= 0xF3) {
+    n = 4;
+  } else {
+    return 0;
+  }
+
+  if (len - i < n || s[i + 1] < lo || s[i + 1] > hi) {
+    return 0;
+  }
+  for (size_t k = 2; k < n; k++) {
+    if ((s[i + k] & 0xC0) != 0x80) {
+      return 0;
+    }
+  }
+  return n;
+}
+
+bool string_valid_utf8(const char *str, size_t len)
+{
+  const unsigned char *s = (const unsigned char*)str;
+#ifdef STRING_AVX2
+  bool avx2 = len >= 64 && has_avx2();
+#endif
+  size_t i = 0;
+  while (true) {
+#ifdef STRING_AVX2
+    i = avx2 ? skip_ascii_avx2(s, len, i) : skip_ascii(s, len, i);
+#else
+    i = skip_ascii(s, len, i);
+#endif
+    if (i == len) {
+      return true;
+    }
+    size_t n = utf8_sequence(s, len, i);
+    if (n == 0) {
+      return false;
+    }
+    i += n;
+  }
+}
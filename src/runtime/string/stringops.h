@@ -0,0 +1,45 @@
+#ifndef __stringops_h__
+#define __stringops_h__
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+// Byte-string kernels backing the String module. All functions work on an
+// explicit length and never read past it, so strings need not be
+// terminated. Case conversion and whitespace follow the "C" locale.
+
+/** Find the first occurrence of a pattern
+ *
+ * @param s The string to search in, of length \p len
+ * @param p The pattern to search for, of length \p plen
+ * @param from The index to start searching at
+ * @return The index of the first occurrence at or after \p from, or -1
+ */
+int64_t string_find(const char *s, size_t len, const char *p, size_t plen,
+                    size_t from);
+
+/// As string_find, but ignores the case of ASCII letters
+int64_t string_find_ignore_case(const char *s, size_t len, const char *p,
+                                size_t plen, size_t from);
+
+/// Count the non-overlapping occurrences of a non-empty pattern
+size_t string_count(const char *s, size_t len, const char *p, size_t plen);
+
+/// Copy \p len bytes from \p src to \p dst, converting to upper case
+void string_to_upper(char *dst, const char *src, size_t len);
+
+/// Copy \p len bytes from \p src to \p dst, converting to lower case
+void string_to_lower(char *dst, const char *src, size_t len);
+
+/** Find the part of a string that is not leading or trailing whitespace
+ *
+ * @param start Set to the index of the first non-whitespace byte
+ * @param stop Set to one past the index of the last non-whitespace byte
+ */
+void string_trim(const char *s, size_t len, size_t *start, size_t *stop);
+
+/// Check that a string is well-formed UTF-8
+bool string_valid_utf8(const char *s, size_t len);
+
+#endif
@@ -29,7 +29,7 @@ void tuple_trace(pony_ctx_t *ctx, void *p)
       else
       if (tuple->types[i] != ENCORE_PRIMITIVE)
         {
-          encore_trace_object(ctx, tuple->elements[i].p, tuple->types[i]->trace);
+          encore_trace_known(ctx, tuple->elements[i].p, tuple->types[i]);
         }
     }
 }
@@ -0,0 +1,5 @@
+#!/bin/sh
+# The report of --encoreprofile goes to stderr and its timings differ from
+# run to run, so only the name and count of each message are kept.
+./Profiled --encoreprofile 2>&1 >/dev/null | awk 'NR > 2 { print $1, $2 }' |
+  LC_ALL=C sort